@@ -0,0 +1,128 @@
+// clone + simulate + discard throughput, i.e. cost of one lookahead future
+//
+// usage: bench/clone [futures] [turns per future]
+
+#define RL_IMPLEMENTATION
+#include "lib/roguelike.h"
+
+#include "game/game.h"
+#include "game/context.h"
+#include "game/table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_SEED    1234
+#define WARMUP_TURNS  200
+#define FUTURES       2000
+#define FUTURE_TURNS  20
+
+// keys a future is played with, no menus or resting so no state leaks
+// between futures through gameloop
+static const char keys[] = "hjklhjklhjklg";
+static unsigned int keySeed = 1;
+
+int future_key()
+{
+    // own LCG, the game RNG is part of what is being simulated
+    keySeed = keySeed * 1103515245 + 12345;
+
+    return keys[(keySeed >> 16) % (sizeof(keys) - 1)];
+}
+
+double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+double median(double *samples, int count)
+{
+    qsort(samples, count, sizeof(double), compare_doubles);
+
+    return samples[count / 2];
+}
+
+int play(Game *game, Dungeon *dungeon, int turns)
+{
+    int result = GAME_PLAYING;
+    for (int i = 0; i < turns && result == GAME_PLAYING; ++i)
+        result = gameloop(game, dungeon, handle_input(game, dungeon) ? future_key() : '.');
+
+    return result;
+}
+
+int main(int argc, const char **argv)
+{
+    int futures = argc > 1 ? atoi(argv[1]) : FUTURES;
+    int turns = argc > 2 ? atoi(argv[2]) : FUTURE_TURNS;
+    if (futures <= 0 || turns <= 0)
+    {
+        printf("Usage: bench/clone [futures] [turns per future]\n");
+
+        return 99;
+    }
+
+    init_tables();
+
+    Game *game = create_game();
+    Dungeon *dungeon = game ? create_dungeon(game, BENCH_SEED) : NULL;
+    if (dungeon == NULL || !init_level(game, dungeon->level, dungeon->player))
+        return 1;
+    update_fov(dungeon->level);
+
+    // keep the player alive so every future is played to the end
+    dungeon->player->hp = dungeon->player->maxHP = 100000;
+    play(game, dungeon, WARMUP_TURNS);
+
+    double *cloneTimes = malloc(sizeof(double) * futures);
+    double *playTimes = malloc(sizeof(double) * futures);
+    double *discardTimes = malloc(sizeof(double) * futures);
+    if (!cloneTimes || !playTimes || !discardTimes)
+        return 1;
+
+    long playedTurns = 0;
+    double start = now();
+    for (int i = 0; i < futures; ++i)
+    {
+        double t0 = now();
+        Dungeon *future = clone_dungeon(game, dungeon);
+        Game *futureGame = clone_game(game);
+        if (futureGame == NULL || future == NULL)
+            return 1;
+
+        double t1 = now();
+        int turn = future->turn;
+        play(futureGame, future, turns);
+        playedTurns += future->turn - turn;
+
+        double t2 = now();
+        destroy_dungeon(future);
+        destroy_game(futureGame);
+
+        double t3 = now();
+        cloneTimes[i] = t1 - t0;
+        playTimes[i] = t2 - t1;
+        discardTimes[i] = t3 - t2;
+    }
+    double elapsed = now() - start;
+
+    printf("%d futures of %d turns in %.3f seconds\n", futures, turns, elapsed);
+    printf("futures per second: %.0f\n", futures / elapsed);
+    printf("turns per second:   %.0f\n", playedTurns / elapsed);
+    printf("median clone:       %.2f us\n", median(cloneTimes, futures) * 1e6);
+    printf("median simulate:    %.2f us\n", median(playTimes, futures) * 1e6);
+    printf("median discard:     %.2f us\n", median(discardTimes, futures) * 1e6);
+
+    return 0;
+}
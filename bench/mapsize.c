@@ -0,0 +1,155 @@
+// cost of generation, FOV, mob AI & rendering as levels get bigger
+//
+// usage: bench/mapsize [samples]
+
+#define RL_IMPLEMENTATION
+#include "lib/roguelike.h"
+
+#include "game/game.h"
+#include "game/context.h"
+#include "game/table.h"
+#include "game/draw.h"
+#include "game/bot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_SEED    1234
+#define WARMUP_TURNS  200
+#define SAMPLES       200 // of each operation, per map size
+#define LEVELS        5   // generated per map size
+
+// map sizes to compare, the first one is the default
+static const unsigned int sizes[][2] = {
+    { MAX_WIDTH, MAX_HEIGHT },
+    { 160, 60 },
+    { 256, 256 },
+    { 512, 512 },
+    { 1024, 1024 },
+};
+
+double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+double median(double *samples, int count)
+{
+    qsort(samples, count, sizeof(double), compare_doubles);
+
+    return samples[count / 2];
+}
+
+// new game with the player on the first level
+Dungeon *start(Game *game, unsigned long seed)
+{
+    reset_game(game);
+    Dungeon *dungeon = create_dungeon(game, seed);
+    if (dungeon == NULL || !init_level(game, dungeon->level, dungeon->player))
+        return NULL;
+    update_fov(dungeon->level);
+
+    // keep the player alive, mobs should keep chasing
+    dungeon->player->hp = dungeon->player->maxHP = 100000;
+
+    return dungeon;
+}
+
+int main(int argc, const char **argv)
+{
+    int samples = argc > 1 ? atoi(argv[1]) : SAMPLES;
+    if (samples <= 0)
+    {
+        printf("Usage: bench/mapsize [samples]\n");
+
+        return 99;
+    }
+
+    init_tables();
+
+    Game *game = create_game();
+    double *times = malloc(sizeof(double) * (samples > LEVELS ? samples : LEVELS));
+    if (game == NULL || times == NULL)
+        return 1;
+
+    printf("median us       generate        fov       mobs     render\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        game->mapWidth = sizes[s][0];
+        game->mapHeight = sizes[s][1];
+
+        // create & generate the first level of a new game
+        for (int i = 0; i < LEVELS; ++i)
+        {
+            double t = now();
+            Dungeon *dungeon = start(game, BENCH_SEED + i);
+            times[i] = now() - t;
+            if (dungeon == NULL)
+                return 1;
+            destroy_dungeon(dungeon);
+        }
+        double generate = median(times, LEVELS);
+
+        // let the bot walk around a bit, so there is something to see
+        Dungeon *dungeon = start(game, BENCH_SEED);
+        Bot bot;
+        if (dungeon == NULL)
+            return 1;
+        init_bot(&bot, dungeon->seed);
+        for (int i = 0; i < WARMUP_TURNS; ++i)
+            gameloop(game, dungeon, handle_input(game, dungeon) ? bot_input(&bot, game, dungeon) : '.');
+        Level *level = dungeon->level;
+
+        // look around from random tiles
+        RL_Point home = dungeon->player->coords;
+        for (int i = 0; i < samples; ++i)
+        {
+            random_free_coords(level, &level->passable, FREE_ANY, &level->rng, &dungeon->player->coords);
+            double t = now();
+            update_fov(level);
+            times[i] = now() - t;
+        }
+        double fov = median(times, samples);
+        dungeon->player->coords = home;
+        update_fov(level);
+
+        for (int i = 0; i < samples; ++i)
+        {
+            double t = now();
+            tick_mobs(game, level);
+            times[i] = now() - t;
+        }
+        double mobs = median(times, samples);
+
+        for (int i = 0; i < samples; ++i)
+        {
+            double t = now();
+            render_frame(game, dungeon);
+            times[i] = now() - t;
+        }
+        double render = median(times, samples);
+
+        printf("%4ux%-4u  %12.1f %10.2f %10.2f %10.2f\n",
+                sizes[s][0], sizes[s][1],
+                generate * 1e6, fov * 1e6, mobs * 1e6, render * 1e6);
+
+        destroy_bot(&bot);
+        destroy_dungeon(dungeon);
+    }
+
+    free(times);
+    destroy_game(game);
+
+    return 0;
+}
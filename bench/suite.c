@@ -0,0 +1,308 @@
+// median & p99 cost of each hot path of the game, as JSON to track
+// regressions between releases
+//
+// usage: bench/suite [samples]
+
+#define RL_IMPLEMENTATION
+#include "lib/roguelike.h"
+
+#include "game/game.h"
+#include "game/context.h"
+#include "game/table.h"
+#include "game/draw.h"
+#include "game/bot.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_SEED     1234
+#define WARMUP_TURNS   200
+#define WARMUP_SAMPLES 20  // of each operation, not reported
+#define SAMPLES        500 // of each operation
+#define BATCH          100 // calls per sample of the cheap operations
+
+// state shared by the operations
+typedef struct {
+    Game *game;
+    Dungeon *dungeon; // the bot has played for a bit, see play
+    unsigned long seed; // of the next dungeon to create
+    RNG rng; // for the operations that take a stream (see run for the game's)
+    Mob mobs[BATCH];
+    Item *items[BATCH];
+} Bench;
+
+// runs operation once (or BATCH times) & returns how long it took
+typedef double (*BenchOp)(Bench *bench);
+
+typedef struct {
+    const char *name;
+    BenchOp op;
+    int batch; // calls per run of op
+    int played; // needs the game the bot played, creating dungeons resets it
+} BenchEntry;
+
+double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+// sorted samples from here on
+double percentile(double *samples, int count, int p)
+{
+    qsort(samples, count, sizeof(double), compare_doubles);
+
+    int i = (int) ((long) count * p / 100);
+
+    return samples[i < count ? i : count - 1];
+}
+
+// new game on the first level, after the bot has played it for a bit
+Dungeon *play(Game *game, Bot *bot)
+{
+    reset_game(game);
+    Dungeon *dungeon = create_dungeon(game, BENCH_SEED);
+    if (dungeon == NULL || !init_level(game, dungeon->level, dungeon->player))
+        return NULL;
+    update_fov(dungeon->level);
+
+    // keep the player alive, mobs should keep chasing
+    dungeon->player->hp = dungeon->player->maxHP = 100000;
+
+    for (int i = 0; i < WARMUP_TURNS; ++i)
+        gameloop(game, dungeon, handle_input(game, dungeon) ? bot_input(bot, game, dungeon) : '.');
+
+    return dungeon;
+}
+
+double bench_create_dungeon(Bench *bench)
+{
+    reset_game(bench->game);
+    double t = now();
+    Dungeon *dungeon = create_dungeon(bench->game, bench->seed++);
+    t = now() - t;
+    if (dungeon == NULL)
+        exit(1);
+    destroy_dungeon(dungeon);
+
+    return t;
+}
+
+// generates the first level of a new game (BSP map, stairs, mobs & items)
+double bench_init_level(Bench *bench)
+{
+    reset_game(bench->game);
+    Dungeon *dungeon = create_dungeon(bench->game, bench->seed++);
+    if (dungeon == NULL)
+        exit(1);
+    double t = now();
+    int ok = init_level(bench->game, dungeon->level, dungeon->player);
+    t = now() - t;
+    if (!ok)
+        exit(1);
+    destroy_dungeon(dungeon);
+
+    return t;
+}
+
+double bench_random_free_coords(Bench *bench)
+{
+    Level *level = bench->dungeon->level;
+    RL_Point coords;
+    double t = now();
+    for (int i = 0; i < BATCH; ++i)
+        random_free_coords(level, &level->passable, FREE_ANY, &bench->rng, &coords);
+
+    return now() - t;
+}
+
+// mostly misses, like most tiles the game asks about
+double bench_get_mob(Bench *bench)
+{
+    Level *level = bench->dungeon->level;
+    RL_Point coords[BATCH];
+    for (int i = 0; i < BATCH; ++i)
+        random_free_coords(level, &level->passable, FREE_ANY, &bench->rng, &coords[i]);
+    double t = now();
+    for (int i = 0; i < BATCH; ++i)
+        get_mob(level, coords[i]);
+
+    return now() - t;
+}
+
+// FOV of the player from a random tile
+double bench_update_fov(Bench *bench)
+{
+    Level *level = bench->dungeon->level;
+    Mob *player = bench->dungeon->player;
+    RL_Point home = player->coords;
+    random_free_coords(level, &level->passable, FREE_ANY, &bench->rng, &player->coords);
+    double t = now();
+    update_fov(level);
+    t = now() - t;
+    player->coords = home;
+    update_fov(level);
+
+    return t;
+}
+
+double bench_tick_mobs(Bench *bench)
+{
+    double t = now();
+    tick_mobs(bench->game, bench->dungeon->level);
+
+    return now() - t;
+}
+
+double bench_alert_mobs(Bench *bench)
+{
+    Level *level = bench->dungeon->level;
+    double t = now();
+    alert_mobs(level, bench->dungeon->player->coords);
+
+    return now() - t;
+}
+
+// headless, into the draw buffer
+double bench_render_frame(Bench *bench)
+{
+    double t = now();
+    render_frame(bench->game, bench->dungeon);
+
+    return now() - t;
+}
+
+double bench_create_mob(Bench *bench)
+{
+    Level *level = bench->dungeon->level;
+    double t = now();
+    for (int i = 0; i < BATCH; ++i)
+        bench->mobs[i] = create_mob(bench->game, level->depth, bench->dungeon->player->coords, &bench->rng);
+    t = now() - t;
+    for (int i = 0; i < BATCH; ++i)
+        destroy_mob(&bench->mobs[i]);
+
+    return t;
+}
+
+// every kind of item but gold, in turn
+double bench_create_item(Bench *bench)
+{
+    int depth = bench->dungeon->level->depth;
+    double t = now();
+    for (int i = 0; i < BATCH; ++i)
+        bench->items[i] = create_item(bench->game, depth, ITEM_WEAPON + i % ITEM_SCROLL);
+    t = now() - t;
+    for (int i = 0; i < BATCH; ++i)
+        free(bench->items[i]);
+
+    return t;
+}
+
+double bench_message(Bench *bench)
+{
+    double t = now();
+    for (int i = 0; i < BATCH; ++i)
+        message(bench->game, "The %s hits! [%d]", mob_name('o'), i);
+
+    return now() - t;
+}
+
+// run entry once & put the game's streams back, so each sample (and the
+// operations after it) rolls the same no matter how many ran before, the
+// dungeon itself still changes (i.e. mobs move in tick_mobs)
+double run(const BenchEntry *entry, Bench *bench)
+{
+    RandomState random = bench->game->random;
+    double t = entry->op(bench);
+    bench->game->random = random;
+
+    return t;
+}
+
+static const BenchEntry entries[] = {
+    { "create_dungeon",     bench_create_dungeon,     1,     0 },
+    { "init_level",         bench_init_level,         1,     0 },
+    { "random_free_coords", bench_random_free_coords, BATCH, 1 },
+    { "get_mob",            bench_get_mob,            BATCH, 1 },
+    { "update_fov",         bench_update_fov,         1,     1 },
+    { "tick_mobs",          bench_tick_mobs,          1,     1 },
+    { "alert_mobs",         bench_alert_mobs,         1,     1 },
+    { "render_frame",       bench_render_frame,       1,     1 },
+    { "create_mob",         bench_create_mob,         BATCH, 1 },
+    { "create_item",        bench_create_item,        BATCH, 1 },
+    { "message",            bench_message,            BATCH, 1 },
+};
+
+int main(int argc, const char **argv)
+{
+    int samples = argc > 1 ? atoi(argv[1]) : SAMPLES;
+    if (samples <= 0)
+    {
+        printf("Usage: bench/suite [samples]\n");
+
+        return 99;
+    }
+
+    init_tables();
+
+    Bench bench;
+    bench.game = create_game();
+    double *times = malloc(sizeof(double) * samples);
+    if (bench.game == NULL || times == NULL)
+        return 1;
+    bench.dungeon = NULL;
+    bench.seed = BENCH_SEED;
+    bench.rng = split_stream(BENCH_SEED, RNG_BOT, 1);
+    Bot bot;
+    init_bot(&bot, BENCH_SEED);
+
+    printf("{\n");
+    printf("  \"seed\": %d,\n", BENCH_SEED);
+    printf("  \"warmup_turns\": %d,\n", WARMUP_TURNS);
+    printf("  \"map\": [%u, %u],\n", bench.game->mapWidth, bench.game->mapHeight);
+    printf("  \"unit\": \"ns\",\n");
+    printf("  \"operations\": {\n");
+    size_t count = sizeof(entries) / sizeof(entries[0]);
+    for (size_t e = 0; e < count; ++e)
+    {
+        const BenchEntry *entry = &entries[e];
+        if (entry->played && bench.dungeon == NULL)
+        {
+            bench.dungeon = play(bench.game, &bot);
+            if (bench.dungeon == NULL)
+                return 1;
+        }
+
+        for (int i = 0; i < WARMUP_SAMPLES; ++i)
+            run(entry, &bench);
+        for (int i = 0; i < samples; ++i)
+            times[i] = run(entry, &bench) / entry->batch;
+
+        double median = percentile(times, samples, 50);
+        double p99 = percentile(times, samples, 99);
+        printf("    \"%s\": { \"median\": %.1f, \"p99\": %.1f, \"samples\": %d, \"batch\": %d }%s\n",
+                entry->name, median * 1e9, p99 * 1e9, samples, entry->batch,
+                e + 1 < count ? "," : "");
+    }
+    printf("  }\n");
+    printf("}\n");
+
+    destroy_bot(&bot);
+    if (bench.dungeon)
+        destroy_dungeon(bench.dungeon);
+    free(times);
+    destroy_game(bench.game);
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ArenaChunk_t {
+    struct ArenaChunk_t *next;
+    size_t size; // bytes after the header
+    size_t used;
+} ArenaChunk;
+
+typedef struct ArenaBlock_t {
+    struct ArenaBlock_t *next;
+} ArenaBlock;
+
+struct Arena_t {
+    ArenaChunk *chunks; // newest first, blocks are cut from the first one
+    size_t used;
+    size_t size;
+    ArenaBlock *free[ARENA_FREE_LISTS]; // given back blocks by size
+};
+
+// bytes of header before the blocks of a chunk
+#define ARENA_CHUNK_HEADER ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN)
+
+ArenaChunk *create_arena_chunk(size_t size);
+Arena *create_arena()
+{
+    // arena lives in its first chunk
+    ArenaChunk *chunk = create_arena_chunk(ARENA_CHUNK_SIZE);
+    if (chunk == NULL)
+        return NULL;
+
+    Arena *arena = (Arena*) ((char*) chunk + ARENA_CHUNK_HEADER);
+    chunk->used = (sizeof(Arena) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    memset(arena, 0, sizeof(Arena));
+    arena->chunks = chunk;
+    arena->size = ARENA_CHUNK_HEADER + chunk->size;
+
+    return arena;
+}
+
+void destroy_arena(Arena *arena)
+{
+    if (arena == NULL)
+        return;
+
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk)
+    {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = size ? (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN : ARENA_ALIGN;
+
+    // reuse a block of the same size
+    size_t list = size / ARENA_ALIGN - 1;
+    if (list < ARENA_FREE_LISTS && arena->free[list])
+    {
+        ArenaBlock *block = arena->free[list];
+        arena->free[list] = block->next;
+        arena->used += size;
+
+        return block;
+    }
+
+    ArenaChunk *chunk = arena->chunks;
+    if (chunk->size - chunk->used < size)
+    {
+        // big blocks get a chunk of their own, behind the current one so it
+        // can still be filled
+        chunk = create_arena_chunk(size > ARENA_CHUNK_SIZE / 2 ? size : ARENA_CHUNK_SIZE);
+        if (chunk == NULL)
+            return NULL;
+
+        if (size > ARENA_CHUNK_SIZE / 2)
+        {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        }
+        else
+        {
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+        }
+        arena->size += ARENA_CHUNK_HEADER + chunk->size;
+    }
+
+    void *block = (char*) chunk + ARENA_CHUNK_HEADER + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+
+    return block;
+}
+
+void *arena_calloc(Arena *arena, size_t size)
+{
+    void *block = arena_alloc(arena, size);
+    if (block)
+        memset(block, 0, size);
+
+    return block;
+}
+
+void arena_free(Arena *arena, void *block, size_t size)
+{
+    if (block == NULL)
+        return;
+
+    size = size ? (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN : ARENA_ALIGN;
+    arena->used -= size;
+
+    // bigger blocks stay where they are until the arena is destroyed
+    size_t list = size / ARENA_ALIGN - 1;
+    if (list < ARENA_FREE_LISTS)
+    {
+        ArenaBlock *free = block;
+        free->next = arena->free[list];
+        arena->free[list] = free;
+    }
+}
+
+void arena_clear(Arena *arena, size_t keep)
+{
+    // keep the chunk the arena lives in, it has the first blocks
+    ArenaChunk *first = (ArenaChunk*) ((char*) arena - ARENA_CHUNK_HEADER);
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk)
+    {
+        ArenaChunk *next = chunk->next;
+        if (chunk != first)
+            free(chunk);
+        chunk = next;
+    }
+
+    keep = (keep + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    first->next = NULL;
+    first->used = (sizeof(Arena) + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN + keep;
+    arena->chunks = first;
+    arena->used = keep;
+    arena->size = ARENA_CHUNK_HEADER + first->size;
+    memset(arena->free, 0, sizeof(arena->free));
+}
+
+size_t arena_used(const Arena *arena)
+{
+    return arena->used;
+}
+
+size_t arena_size(const Arena *arena)
+{
+    return arena->size;
+}
+
+/*************/
+/**         **/
+/** private **/
+/**         **/
+/*************/
+
+ArenaChunk *create_arena_chunk(size_t size)
+{
+    ArenaChunk *chunk = malloc(ARENA_CHUNK_HEADER + size);
+    if (chunk == NULL)
+        return NULL;
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    return chunk;
+}
@@ -0,0 +1,40 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#define ARENA_CHUNK_SIZE  65536 // bytes allocated at once
+#define ARENA_ALIGN       16
+#define ARENA_FREE_LISTS  16    // sizes up to ARENA_FREE_LISTS * ARENA_ALIGN are reused
+
+#include <stddef.h>
+
+// Memory that is freed all at once, i.e. the Level struct, tile sets &
+// floor items of one level (its map, FOV, mob inventories & paths are
+// allocated on their own). Blocks are cut from big chunks & never freed on
+// their own, small blocks that are given back (see arena_free) are reused
+// for the next block of the same size.
+typedef struct Arena_t Arena;
+
+// returns NULL on OOM
+Arena *create_arena();
+
+// free every block of arena & arena itself
+void destroy_arena(Arena *arena);
+
+// returns NULL on OOM
+void *arena_alloc(Arena *arena, size_t size);
+
+// same as arena_alloc, but zeroed
+void *arena_calloc(Arena *arena, size_t size);
+
+// give a block of size back for reuse
+void arena_free(Arena *arena, void *block, size_t size);
+
+// free every block but the first keep bytes of them, which have to be in
+// the first chunk (i.e. the level itself when it's packed)
+void arena_clear(Arena *arena, size_t keep);
+
+// bytes of blocks in use & bytes allocated for arena
+size_t arena_used(const Arena *arena);
+size_t arena_size(const Arena *arena);
+
+#endif
@@ -0,0 +1,241 @@
+#include "bot.h"
+#include "game.h"
+#include "context.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// movement keys & their directions
+static const char botKeys[4] = { 'h', 'l', 'j', 'k' };
+static const Direction botDirs[4] = { { -1, 0 }, { 1, 0 }, { 0, 1 }, { 0, -1 } };
+
+void score_bot_level(Bot *bot, const Level *level);
+int bot_explore(Bot *bot, const Level *level, int x, int y);
+int bot_healing_potion(const Mob *player);
+int bot_sees_mobs(const Level *level);
+
+void init_bot(Bot *bot, unsigned long seed)
+{
+    bot->level = NULL;
+    bot->width = bot->height = 0;
+    bot->distance = NULL;
+    bot->step = NULL;
+    bot->queue = NULL;
+    bot->capacity = 0;
+    bot->rng = split_stream(seed, RNG_BOT, 0);
+}
+
+void destroy_bot(Bot *bot)
+{
+    free(bot->distance);
+    free(bot->step);
+    free(bot->queue);
+    init_bot(bot, 0); // seeded again for the next game
+}
+
+int bot_input(Bot *bot, const Game *game, const Dungeon *dungeon)
+{
+    const Level *level = dungeon->level;
+    const Mob *player = dungeon->player;
+    int x = player->coords.x, y = player->coords.y;
+
+    // pick the potion after asking to quaff, back out of any other menu
+    int menu = get_menu(game);
+    if (menu == MENU_QUAFF && bot_healing_potion(player) > 0)
+        return item_menu_symbol(bot_healing_potion(player) - 1);
+    if (menu)
+        return 27;
+
+    if (bot->level != level)
+        score_bot_level(bot, level);
+
+    // drink up when low, even in a fight
+    if (player->hp <= player->maxHP / 3 && bot_healing_potion(player) > 0)
+        return 'q';
+
+    // fight anything next to us
+    for (int i = 0; i < 4; ++i)
+        if (get_enemy(level, RL_XY(x + botDirs[i].xdir, y + botDirs[i].ydir)))
+            return botKeys[i];
+
+    // pick up items while there's room for them
+    if (floor_stack(&level->floor, x, y) &&
+            player->inventory->itemCount < MAX_INVENTORY_ITEMS)
+        return 'g';
+
+    if (x == level->downstair_loc.x && y == level->downstair_loc.y)
+        return '>';
+
+    // rest up while it's safe
+    if (player->hp < player->maxHP / 2 && !bot_sees_mobs(level))
+        return 'R';
+
+    // explore until the downstair has been seen, then head there
+    int dir = bot_explore(bot, level, x, y);
+    if (dir != -1)
+        return botKeys[dir];
+
+    // nothing left to explore that leads anywhere, step towards the
+    // downstair the way the level was generated
+    int width = bot->width, best = -1;
+    for (int i = 0; i < 4; ++i)
+    {
+        int nx = x + botDirs[i].xdir, ny = y + botDirs[i].ydir;
+        if (nx < 0 || ny < 0 || nx >= width || ny >= (int) bot->height || bot->distance[ny * width + nx] < 0)
+            continue;
+        if (bot->distance[ny * width + nx] < bot->distance[y * width + x] &&
+                (best == -1 || bot->distance[ny * width + nx] < bot->distance[(y + botDirs[best].ydir) * width + x + botDirs[best].xdir]))
+            best = i;
+    }
+    if (best != -1)
+        return botKeys[best];
+
+    // no way down from here, wander
+    return botKeys[generate(&bot->rng, 0, 3)];
+}
+
+/*************/
+/**         **/
+/** private **/
+/**         **/
+/*************/
+
+// breadth first distance of every tile to the downstair
+void score_bot_level(Bot *bot, const Level *level)
+{
+    int width = level->width, height = level->height;
+    size_t area = (size_t) width * height;
+    if (area > bot->capacity)
+    {
+        free(bot->distance);
+        free(bot->step);
+        free(bot->queue);
+        bot->distance = malloc(area * sizeof(int));
+        bot->step = malloc(area);
+        bot->queue = malloc(area * sizeof(int));
+        assert(bot->distance && bot->step && bot->queue);
+        memset(bot->step, -1, area);
+        bot->capacity = area;
+    }
+    bot->width = width;
+    bot->height = height;
+
+    int *queue = bot->queue;
+    int head = 0, tail = 0;
+
+    for (size_t i = 0; i < area; ++i)
+        bot->distance[i] = -1;
+
+    int sx = level->downstair_loc.x, sy = level->downstair_loc.y;
+    bot->distance[sy * width + sx] = 0;
+    queue[tail++] = sy * width + sx;
+    while (head < tail)
+    {
+        int x = queue[head] % width, y = queue[head] / width;
+        ++head;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            int nx = x + botDirs[i].xdir, ny = y + botDirs[i].ydir;
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height ||
+                    bot->distance[ny * width + nx] != -1 ||
+                    !rl_map_is_passable(level->map, nx, ny))
+                continue;
+
+            bot->distance[ny * width + nx] = bot->distance[y * width + x] + 1;
+            queue[tail++] = ny * width + nx;
+        }
+    }
+
+    bot->level = level;
+}
+
+// 1 if the player has seen tile
+int bot_knows(const Level *level, int x, int y)
+{
+    return rl_fov_is_visible(level->fov, x, y) || rl_fov_is_seen(level->fov, x, y);
+}
+
+// 1 if tile is a goal for exploring: the downstair once it's known,
+// otherwise a known tile next to an unexplored passable one
+int bot_goal(const Level *level, int x, int y, int stairsKnown)
+{
+    if (stairsKnown)
+        return x == level->downstair_loc.x && y == level->downstair_loc.y;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        int nx = x + botDirs[i].xdir, ny = y + botDirs[i].ydir;
+        if (nx >= 0 && ny >= 0 && nx < (int) level->width && ny < (int) level->height &&
+                !bot_knows(level, nx, ny) && rl_map_is_passable(level->map, nx, ny))
+            return 1;
+    }
+
+    return 0;
+}
+
+// breadth first search over known tiles for the closest goal
+// returns index of the first move towards it, -1 if there is none
+int bot_explore(Bot *bot, const Level *level, int x, int y)
+{
+    int width = bot->width, height = bot->height;
+    int *queue = bot->queue;
+    signed char *step = bot->step;
+    int head = 0, tail = 0;
+    int stairsKnown = bot_knows(level, level->downstair_loc.x, level->downstair_loc.y);
+    int dir = -1;
+
+    step[y * width + x] = 4; // start, never a goal
+    queue[tail++] = y * width + x;
+    while (head < tail)
+    {
+        int cx = queue[head] % width, cy = queue[head] / width;
+        ++head;
+
+        if (step[cy * width + cx] != 4 && bot_goal(level, cx, cy, stairsKnown))
+        {
+            dir = step[cy * width + cx];
+            break;
+        }
+
+        for (int i = 0; i < 4; ++i)
+        {
+            int nx = cx + botDirs[i].xdir, ny = cy + botDirs[i].ydir;
+            if (nx < 0 || ny < 0 || nx >= width || ny >= height ||
+                    step[ny * width + nx] != -1 ||
+                    !bot_knows(level, nx, ny) ||
+                    !rl_map_is_passable(level->map, nx, ny))
+                continue;
+
+            // the first move is inherited from the tile we came from
+            step[ny * width + nx] = step[cy * width + cx] == 4 ? i : step[cy * width + cx];
+            queue[tail++] = ny * width + nx;
+        }
+    }
+
+    // only clear what was searched, not the whole map
+    for (int i = 0; i < tail; ++i)
+        step[queue[i]] = -1;
+
+    return dir;
+}
+
+// inventory index of a healing potion, -1 if there is none
+int bot_healing_potion(const Mob *player)
+{
+    const Inventory *inventory = player->inventory;
+    for (int i = 1; inventory && i < inventory->itemCount; ++i)
+        if (inventory->items[i]->type == ITEM_POTION && inventory->items[i]->potion == POTION_HEAL)
+            return i;
+
+    return -1;
+}
+
+int bot_sees_mobs(const Level *level)
+{
+    for (int i = 0; i < level->mobCount; ++i)
+        if (rl_fov_is_visible(level->fov, level->mobs[i].coords.x, level->mobs[i].coords.y))
+            return 1;
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include "dungeon.h"
+#include "random.h"
+
+// Built-in player for headless games, benchmarks & soak tests. It explores
+// the closest unexplored part of the level until it has seen the
+// downstair, then walks there & descends. On the way it fights whatever is
+// next to it, picks up items, drinks healing potions when low & rests when
+// hurt with nothing in sight.
+
+typedef struct {
+    const Level *level; // level distance was scored for
+    unsigned int width, height; // map size of level
+    int *distance; // steps to downstair per tile, -1 if unreachable
+    signed char *step; // first move towards tile, -1 outside of bot_input
+    int *queue; // tiles to search
+    size_t capacity; // tiles the buffers above have room for
+    RNG rng; // for moves when stuck, the game's streams are never used
+} Bot;
+
+// reset bot for a new game of the dungeon with seed
+void init_bot(Bot *bot, unsigned long seed);
+
+// free the buffers of bot after a game (not bot itself)
+void destroy_bot(Bot *bot);
+
+// return key for the bot to play this turn (only ask when handle_input
+// says input is needed)
+int bot_input(Bot *bot, const Game *game, const Dungeon *dungeon);
+
+#endif
@@ -0,0 +1,161 @@
+#include "broadcast.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#define BROADCAST_JOINING UINT64_MAX // reader offset until it has a keyframe
+
+Broadcast *create_broadcast(unsigned long id)
+{
+    Broadcast *broadcast = calloc(1, sizeof(Broadcast));
+    if (broadcast == NULL)
+        return NULL;
+
+    broadcast->id = id;
+    pthread_mutex_init(&broadcast->lock, NULL);
+    atomic_init(&broadcast->readers, 0);
+    atomic_init(&broadcast->refs, 1);
+
+    return broadcast;
+}
+
+void retain_broadcast(Broadcast *broadcast)
+{
+    atomic_fetch_add(&broadcast->refs, 1);
+}
+
+void release_broadcast(Broadcast *broadcast)
+{
+    if (atomic_fetch_sub(&broadcast->refs, 1) != 1)
+        return;
+
+    pthread_mutex_destroy(&broadcast->lock);
+    free(broadcast->ring);
+    free(broadcast);
+}
+
+int broadcast_mode(Broadcast *broadcast)
+{
+    // nobody watching, skip the lock
+    if (atomic_load(&broadcast->readers) == 0)
+        return BROADCAST_IDLE;
+
+    pthread_mutex_lock(&broadcast->lock);
+    int keyframe = !broadcast->hasKeyframe || broadcast->head - broadcast->keyframe >= BROADCAST_INTERVAL;
+    pthread_mutex_unlock(&broadcast->lock);
+
+    return keyframe ? BROADCAST_KEYFRAME : BROADCAST_DELTA;
+}
+
+int broadcast_frame(Broadcast *broadcast, const char *frame, size_t length, int keyframe)
+{
+    pthread_mutex_lock(&broadcast->lock);
+    if (length > BROADCAST_SIZE - BROADCAST_INTERVAL)
+    {
+        // readers would apply later deltas to a stale screen, so ask for a
+        // keyframe next
+        broadcast->hasKeyframe = 0;
+        pthread_mutex_unlock(&broadcast->lock);
+
+        return 0;
+    }
+
+    if (broadcast->ring == NULL)
+    {
+        pthread_mutex_unlock(&broadcast->lock);
+
+        return 1; // no reader has joined yet
+    }
+
+    if (keyframe)
+    {
+        broadcast->keyframe = broadcast->head;
+        broadcast->hasKeyframe = 1;
+    }
+
+    // copy in up to two parts around the end of the ring
+    size_t start = broadcast->head % BROADCAST_SIZE;
+    size_t first = length < BROADCAST_SIZE - start ? length : BROADCAST_SIZE - start;
+    memcpy(broadcast->ring + start, frame, first);
+    memcpy(broadcast->ring, frame + first, length - first);
+    broadcast->head += length;
+    pthread_mutex_unlock(&broadcast->lock);
+
+    return 1;
+}
+
+void end_broadcast(Broadcast *broadcast)
+{
+    pthread_mutex_lock(&broadcast->lock);
+    broadcast->ended = 1;
+    pthread_mutex_unlock(&broadcast->lock);
+}
+
+int join_broadcast(Broadcast *broadcast, uint64_t *offset)
+{
+    pthread_mutex_lock(&broadcast->lock);
+    if (broadcast->ring == NULL)
+        broadcast->ring = malloc(BROADCAST_SIZE);
+    if (broadcast->ring == NULL)
+    {
+        pthread_mutex_unlock(&broadcast->lock);
+
+        return 0;
+    }
+
+    // frames weren't written while nobody was watching, so the last
+    // keyframe is stale
+    if (atomic_load(&broadcast->readers) == 0)
+        broadcast->hasKeyframe = 0;
+    atomic_fetch_add(&broadcast->readers, 1);
+    *offset = BROADCAST_JOINING;
+    pthread_mutex_unlock(&broadcast->lock);
+
+    return 1;
+}
+
+void leave_broadcast(Broadcast *broadcast)
+{
+    atomic_fetch_sub(&broadcast->readers, 1);
+}
+
+int send_broadcast(Broadcast *broadcast, uint64_t *offset, int fd)
+{
+    int result = BROADCAST_SENT;
+
+    pthread_mutex_lock(&broadcast->lock);
+
+    // fell behind far enough that the ring was overwritten
+    if (*offset != BROADCAST_JOINING && broadcast->head - *offset > BROADCAST_SIZE)
+        *offset = BROADCAST_JOINING;
+    if (*offset == BROADCAST_JOINING &&
+            broadcast->hasKeyframe &&
+            broadcast->head - broadcast->keyframe <= BROADCAST_SIZE)
+        *offset = broadcast->keyframe;
+
+    while (*offset != BROADCAST_JOINING && *offset < broadcast->head)
+    {
+        size_t start = *offset % BROADCAST_SIZE;
+        size_t length = broadcast->head - *offset;
+        if (length > BROADCAST_SIZE - start)
+            length = BROADCAST_SIZE - start;
+
+        ssize_t sent = send(fd, broadcast->ring + start, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent < 0)
+        {
+            result = errno == EAGAIN || errno == EWOULDBLOCK ? BROADCAST_BLOCKED : -1;
+            break;
+        }
+
+        *offset += sent;
+    }
+
+    if (result == BROADCAST_SENT && broadcast->ended)
+        result = BROADCAST_ENDED;
+    pthread_mutex_unlock(&broadcast->lock);
+
+    return result;
+}
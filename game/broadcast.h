@@ -0,0 +1,69 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Stream of frames from one writer to many readers, i.e. a live game to its
+// spectators. Each frame is encoded once & appended to a ring buffer that
+// readers send straight out of, every reader only keeps its offset. Once
+// enough delta frames were written the writer is asked for a keyframe that
+// doesn't depend on earlier frames: readers that join late or fall too far
+// behind start from the latest one.
+
+#define BROADCAST_SIZE     (1 << 16) // bytes of frames kept for readers
+#define BROADCAST_INTERVAL (1 << 14) // bytes of delta frames between keyframes
+
+#define BROADCAST_IDLE     0 // no readers, don't bother encoding frames
+#define BROADCAST_DELTA    1
+#define BROADCAST_KEYFRAME 2
+
+#define BROADCAST_BLOCKED 0 // reader socket is full
+#define BROADCAST_SENT    1 // reader has every frame so far
+#define BROADCAST_ENDED   2 // reader has every frame & the broadcast ended
+
+typedef struct {
+    unsigned long id; // for readers to pick a broadcast
+    pthread_mutex_t lock;
+    char *ring; // allocated once the first reader joins
+    uint64_t head; // bytes written so far
+    uint64_t keyframe; // offset of the latest keyframe
+    int hasKeyframe; // 0 until the first keyframe
+    int ended;
+    atomic_int readers;
+    atomic_int refs;
+} Broadcast;
+
+// create broadcast with one reference
+// returns NULL on OOM
+Broadcast *create_broadcast(unsigned long id);
+
+// add & drop a reference, the broadcast is freed with the last one
+void retain_broadcast(Broadcast *broadcast);
+void release_broadcast(Broadcast *broadcast);
+
+// what the writer should encode its next frame as, BROADCAST consts
+int broadcast_mode(Broadcast *broadcast);
+
+// append frame, a keyframe if mode said so
+// returns 0 if the frame doesn't fit the ring (it's dropped & the next
+// frame has to be a keyframe)
+int broadcast_frame(Broadcast *broadcast, const char *frame, size_t length, int keyframe);
+
+// mark the end of the broadcast, readers finish after the last frame
+void end_broadcast(Broadcast *broadcast);
+
+// start reading broadcast from the next keyframe, offset is for
+// send_broadcast
+// returns 0 on OOM
+int join_broadcast(Broadcast *broadcast, uint64_t *offset);
+void leave_broadcast(Broadcast *broadcast);
+
+// send frames after offset to non-blocking socket fd, straight out of the
+// ring
+// returns BROADCAST consts, -1 on socket error
+int send_broadcast(Broadcast *broadcast, uint64_t *offset, int fd);
+
+#endif
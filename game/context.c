@@ -0,0 +1,59 @@
+#include "context.h"
+#include "save.h"
+#include <stdlib.h>
+#include <string.h>
+
+Game *create_game()
+{
+    Game *game = malloc(sizeof(Game));
+    if (game == NULL)
+        return NULL;
+
+    memset(game, 0, sizeof(Game));
+    game->mapWidth = MAX_WIDTH;
+    game->mapHeight = MAX_HEIGHT;
+    game->viewWidth = MAX_WIDTH;
+    game->viewHeight = MAX_HEIGHT;
+
+    return game;
+}
+
+Game *clone_game(const Game *game)
+{
+    Game *clone = malloc(sizeof(Game));
+    if (clone == NULL)
+        return NULL;
+
+    *clone = *game;
+    clone->autosave = NULL;
+
+    return clone;
+}
+
+void reset_game(Game *game)
+{
+    int hasColor = game->hasColor;
+    const char *autosaveFile = game->autosaveFile;
+    struct Autosave_t *autosave = game->autosave;
+    unsigned int mapWidth = game->mapWidth, mapHeight = game->mapHeight;
+    int viewWidth = game->viewWidth, viewHeight = game->viewHeight;
+
+    memset(game, 0, sizeof(Game));
+    game->hasColor = hasColor;
+    game->autosaveFile = autosaveFile;
+    game->autosave = autosave;
+    game->mapWidth = mapWidth;
+    game->mapHeight = mapHeight;
+    game->viewWidth = viewWidth;
+    game->viewHeight = viewHeight;
+}
+
+void destroy_game(Game *game)
+{
+    if (game == NULL)
+        return;
+
+    finish_autosave(game);
+    free(game->autosave);
+    free(game);
+}
@@ -0,0 +1,55 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "draw.h"
+#include "message.h"
+#include "dungeon.h"
+
+// State of one running game that isn't part of the dungeon itself: player
+// input modes, the message log, item IDs, RNG streams, the world hash,
+// autosaves & the screen buffer. Each game gets its own context, so several
+// games can run in one process. A context must only be used by one thread
+// at a time.
+struct Game_t {
+    // input (see gameloop & handle_input)
+    int resting; // 1 if player resting
+    int inMenu; // one of MENU consts if in menu
+    Direction runDir; // direction player is running
+    const char *autosaveFile; // file to autosave to, if enabled
+    struct Autosave_t *autosave; // last autosave, NULL until the first one (see save.c)
+    unsigned int mapWidth, mapHeight; // level size of new dungeons, MAX_WIDTH by MAX_HEIGHT by default
+
+    // message log, a ring of the last MAX_MESSAGES messages (see get_message)
+    char messages[MAX_MESSAGES][MAX_MESSAGE_LENGTH + 1];
+    int latestMessage; // index of newest message
+    int messageCount;
+
+    int latestItemId; // next unique item ID
+    RandomState random; // combat & loot streams, seeded by create_dungeon
+    uint64_t hash; // world hash (see hash.h)
+    char killer; // symbol of mob that killed the player, 0 if none
+
+    // screen (see render)
+    int hasColor;
+    int viewWidth, viewHeight; // tiles of the map on screen, MAX_WIDTH by MAX_HEIGHT at most
+    RL_Point camera; // map coords of the top left tile on screen
+    DrawTile drawBuffer[MAX_HEIGHT][MAX_WIDTH]; // last frame, only changes are drawn
+};
+
+// create context for a new game
+// returns NULL on OOM
+Game *create_game();
+
+// copy context, i.e. to simulate a cloned dungeon with the same item IDs,
+// RNG streams & world hash (autosaves aren't copied)
+// returns NULL on OOM
+Game *clone_game(const Game *game);
+
+// clear context for the next game, keeps color support, autosaves, map
+// size & view size
+void reset_game(Game *game);
+
+// free context, waits for its autosave to be written
+void destroy_game(Game *game);
+
+#endif
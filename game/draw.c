@@ -1,36 +1,14 @@
+#include "draw.h"
 #include "game.h"
 #include "message.h"
+#include "context.h"
 #include <ncurses.h>
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
 
-#if(NCURSES_WIDECHAR)
-#define SYMBOL wchar_t
-#else
-#define SYMBOL char
-#endif
-
-static int hasColor;
-
-typedef struct DrawTile {
-    SYMBOL symbol;
-    int colorPair; // for curses color
-    int attr;      // bold, etc.
-} DrawTile;
-
-#define COLOR_PAIR_DEFAULT 1
-#define COLOR_PAIR_GREEN   2
-#define COLOR_PAIR_BROWN   3
-#define COLOR_PAIR_YELLOW  4
-#define COLOR_PAIR_BLACK   5
-#define COLOR_PAIR_PURPLE  6
-
-// temporary global to hold previous map state, so we only draw what was changed
-DrawTile drawBuffer[MAX_HEIGHT][MAX_WIDTH];
-
 #include <locale.h>
-int init(int enableColor)
+int init(Game *game, int enableColor)
 {
     setlocale(LC_ALL, "");
     initscr();            /* Start curses mode         */
@@ -38,17 +16,22 @@ int init(int enableColor)
     keypad(stdscr, TRUE); /* We get F1, F2 etc..        */
     noecho();             /* Don't echo() while we do getch */
     curs_set(0);          /* hide cursor */
+    idlok(stdscr, TRUE);  /* scroll with the terminal when the camera moves */
+    idcok(stdscr, TRUE);
 
+    // show as much of the map as fits above the status area
     int mx, my;
     getmaxyx(stdscr, my, mx);
-    if (mx < MAX_WIDTH || my < MAX_HEIGHT) {
+    if (mx < MIN_VIEW_WIDTH || my < MIN_VIEW_HEIGHT + MAX_MESSAGES) {
         endwin();
 
         return 0;
     }
+    game->viewWidth = mx < MAX_WIDTH ? mx : MAX_WIDTH;
+    game->viewHeight = my - MAX_MESSAGES < MAX_HEIGHT ? my - MAX_MESSAGES : MAX_HEIGHT;
 
-    hasColor = enableColor ? has_colors() : 0;
-    if (hasColor) {
+    game->hasColor = enableColor ? has_colors() : 0;
+    if (game->hasColor) {
         start_color();
         use_default_colors();
         init_pair(COLOR_PAIR_DEFAULT, -1,            -1);
@@ -68,39 +51,96 @@ void deinit()
 }
 
 void render_messages();
-void render_message(const char *message, int y, int x); // TODO use this for other messages
-void draw(const DrawTile drawBuffer[][MAX_WIDTH], const DrawTile prevDrawBuffer[][MAX_WIDTH]);
-void draw_status(const Dungeon *dungeon);
+void render_message(Game *game, const char *message, int y, int x); // TODO use this for other messages
+void draw(int hasColor, const DrawTile drawBuffer[][MAX_WIDTH], const DrawTile prevDrawBuffer[][MAX_WIDTH], int width, int height);
+void draw_status(const Game *game, const Dungeon *dungeon);
+void scroll_view(const Game *game, int dx, int dy);
 DrawTile get_tile(Level *level, RL_Point coords);
-void render(const Dungeon *dungeon)
+void render(Game *game, const Dungeon *dungeon)
 {
-    const Mob *player = dungeon->player;
-
     // store previous buffer for comparison
     DrawTile prevDrawBuffer[MAX_HEIGHT][MAX_WIDTH];
-    memcpy(prevDrawBuffer, drawBuffer, sizeof(DrawTile) * MAX_HEIGHT * MAX_WIDTH);
+    memcpy(prevDrawBuffer, game->drawBuffer, sizeof(DrawTile) * MAX_HEIGHT * MAX_WIDTH);
+    RL_Point camera = game->camera;
+
+    render_frame(game, dungeon);
+
+    // shift what is still in view, only what scrolled in is drawn below
+    int dx = game->camera.x - camera.x, dy = game->camera.y - camera.y;
+    if ((dx || dy) && abs(dx) < game->viewWidth && abs(dy) < game->viewHeight)
+    {
+        scroll_frame(prevDrawBuffer, game->viewWidth, game->viewHeight, dx, dy);
+        scroll_view(game, dx, dy);
+    }
+
+    // draw difference from old map & new map
+    draw(game->hasColor, game->drawBuffer, prevDrawBuffer, game->viewWidth, game->viewHeight);
+
+    // draw status area & messages
+    draw_status(game, dungeon);
+}
+
+void render_tiles(Game *game, const DrawTile tiles[][MAX_WIDTH], const char *text)
+{
+    DrawTile prevDrawBuffer[MAX_HEIGHT][MAX_WIDTH];
+    memcpy(prevDrawBuffer, game->drawBuffer, sizeof(DrawTile) * MAX_HEIGHT * MAX_WIDTH);
+    memcpy(game->drawBuffer, tiles, sizeof(DrawTile) * MAX_HEIGHT * MAX_WIDTH);
+
+    draw(game->hasColor, game->drawBuffer, prevDrawBuffer, MAX_WIDTH, MAX_HEIGHT);
+
+    // status area, a line per row
+    for (int y = 0; y < MAX_MESSAGES; ++y)
+    {
+        move(MAX_HEIGHT + y, 0);
+        clrtoeol();
+
+        const char *end = strchr(text, '\n');
+        int length = end ? end - text : (int) strlen(text);
+        addnstr(text, length);
+        text += end ? length + 1 : length;
+    }
+
+    refresh();
+}
+
+void update_camera(Game *game, const Dungeon *dungeon);
+void render_frame(Game *game, const Dungeon *dungeon)
+{
+    const Mob *player = dungeon->player;
+    DrawTile (*drawBuffer)[MAX_WIDTH] = game->drawBuffer;
+    DrawTile blank = { ' ', COLOR_PAIR_DEFAULT, 0 };
+
+    update_camera(game, dungeon);
 
-    // render onto our current map
+    // render the part of the map in view, the rest of the buffer is blank
+    int cx = game->camera.x, cy = game->camera.y;
     for (int y = 0; y < MAX_HEIGHT; ++y)
     {
         for (int x = 0; x < MAX_WIDTH; ++x)
         {
-            drawBuffer[y][x] = get_tile(dungeon->level, RL_XY(x, y));
+            if (x < game->viewWidth && y < game->viewHeight)
+                drawBuffer[y][x] = get_tile(dungeon->level, RL_XY(cx + x, cy + y));
+            else
+                drawBuffer[y][x] = blank;
         }
     }
 
-    if (get_menu() && get_menu() != MENU_DIRECTION)
+    if (get_menu(game) && get_menu(game) != MENU_DIRECTION)
     {
-        if (player->itemCount)
+        const Inventory *inventory = player->inventory;
+        if (inventory && inventory->itemCount)
         {
-            Equipment equipment = player->equipment;
+            Equipment equipment = inventory->equipment;
 
-            // render inventory
+            // render inventory, in as many columns as it takes to fit the
+            // view with a blank between them
             char buffer[MAX_WIDTH + 1]; // width + 1 for null byte
-            int y = 0;
-            for (int i = 0; i < player->itemCount; ++i)
+            int rows = game->viewHeight;
+            int columns = (inventory->itemCount + rows - 1) / rows;
+            int width = game->viewWidth / columns;
+            for (int i = 0; i < inventory->itemCount; ++i)
             {
-                Item *item = player->items[i];
+                Item *item = inventory->items[i];
 
                 bool isEquipped = false;
                 if (item->type == ITEM_WEAPON &&
@@ -117,36 +157,50 @@ void render(const Dungeon *dungeon)
                 else sym = item_menu_symbol(i - 1);
 
                 if (item->amount == 1)
-                    snprintf(buffer, MAX_WIDTH + 1, "%c - %s%s",
+                    snprintf(buffer, width, "%c - %s%s",
                             sym,
                             item->name,
                             isEquipped ? " (equipped)" : "");
                 else // pluralize
                     if (item->pluralName)
-                        snprintf(buffer, MAX_WIDTH + 1, "%c - %d %s%s",
+                        snprintf(buffer, width, "%c - %d %s%s",
                                 sym,
                                 item->amount,
                                 item->pluralName,
                                 isEquipped ? " (equipped)" : "");
                     else
-                        snprintf(buffer, MAX_WIDTH + 1, "%c - %d %ss%s",
+                        snprintf(buffer, width, "%c - %d %ss%s",
                                 sym,
                                 item->amount,
                                 item->name,
                                 isEquipped ? " (equipped)" : "");
 
-                render_message((const char*) buffer, y++, 0);
+                render_message(game, (const char*) buffer, i % rows, i / rows * width);
             }
         }
         else
-            render_message("No items in inventory.", 0, 0);
+            render_message(game, "No items in inventory.", 0, 0);
     }
+}
 
-    // draw difference from old map & new map
-    draw(drawBuffer, prevDrawBuffer);
+void scroll_frame(DrawTile frame[][MAX_WIDTH], int width, int height, int dx, int dy)
+{
+    static const DrawTile scrolledIn = { 0, -1, -1 }; // never a real tile
 
-    // draw status area & messages
-    draw_status(dungeon);
+    for (int y = 0; y < height; ++y)
+    {
+        int row = dy > 0 ? y : height - 1 - y; // don't overwrite rows still to be moved
+        int fromRow = row + dy;
+        for (int x = 0; x < width; ++x)
+        {
+            int col = dx > 0 ? x : width - 1 - x;
+            int fromCol = col + dx;
+            if (fromRow < 0 || fromRow >= height || fromCol < 0 || fromCol >= width)
+                frame[row][col] = scrolledIn;
+            else
+                frame[row][col] = frame[fromRow][fromCol];
+        }
+    }
 }
 
 /*************/
@@ -155,23 +209,83 @@ void render(const Dungeon *dungeon)
 /**         **/
 /*************/
 
-void render_message(const char *message, int y, int x)
+// keep the player CAMERA_MARGIN tiles away from the edges of the view,
+// centered when the player jumped out of view (i.e. on a new level)
+int camera_axis(int camera, int player, int view, int size)
+{
+    int margin = CAMERA_MARGIN < view / 2 ? CAMERA_MARGIN : (view - 1) / 2;
+
+    if (player < camera || player >= camera + view)
+        camera = player - view / 2;
+    else if (player < camera + margin)
+        camera = player - margin;
+    else if (player >= camera + view - margin)
+        camera = player - view + margin + 1;
+
+    if (camera > size - view)
+        camera = size - view;
+    if (camera < 0)
+        camera = 0;
+
+    return camera;
+}
+
+void update_camera(Game *game, const Dungeon *dungeon)
+{
+    const Level *level = dungeon->level;
+    RL_Point player = dungeon->player->coords;
+
+    game->camera.x = camera_axis(game->camera.x, player.x, game->viewWidth, level->width);
+    game->camera.y = camera_axis(game->camera.y, player.y, game->viewHeight, level->height);
+}
+
+// scroll the screen by the camera movement, with the terminal's own scrolling
+// when it has it
+void scroll_view(const Game *game, int dx, int dy)
+{
+    int width = game->viewWidth, height = game->viewHeight;
+
+    if (dy)
+    {
+        setscrreg(0, height - 1);
+        scrollok(stdscr, TRUE);
+        scrl(dy);
+        scrollok(stdscr, FALSE);
+        setscrreg(0, getmaxy(stdscr) - 1);
+    }
+    for (int y = 0; dx && y < height; ++y)
+    {
+        move(y, 0);
+        for (int i = 0; i < abs(dx); ++i)
+            if (dx > 0) delch();
+            else insch(' ');
+        // nothing is shifted past the view on wider terminals
+        if (width < getmaxx(stdscr))
+        {
+            move(y, width);
+            clrtoeol();
+        }
+    }
+}
+
+void render_message(Game *game, const char *message, int y, int x)
 {
     for (size_t i = 0; i < strlen(message); ++i) {
         DrawTile t = {0};
         t.symbol = message[i];
         t.attr = A_BOLD;
         t.colorPair = COLOR_PAIR_DEFAULT;
-        drawBuffer[y][x + i] = t;
+        game->drawBuffer[y][x + i] = t;
     }
 }
 
-// only draw difference in map to curses window
-void draw(const DrawTile drawBuffer[][MAX_WIDTH], const DrawTile prevDrawBuffer[][MAX_WIDTH])
+// only draw difference in map to curses window, of the top left width by
+// height cells
+void draw(int hasColor, const DrawTile drawBuffer[][MAX_WIDTH], const DrawTile prevDrawBuffer[][MAX_WIDTH], int width, int height)
 {
-    for (int y = 0; y < MAX_HEIGHT; ++y)
+    for (int y = 0; y < height; ++y)
     {
-        for (int x = 0; x < MAX_WIDTH; ++x)
+        for (int x = 0; x < width; ++x)
         {
             if (drawBuffer[y][x].symbol != prevDrawBuffer[y][x].symbol ||
                 drawBuffer[y][x].attr != prevDrawBuffer[y][x].attr ||
@@ -201,16 +315,16 @@ void draw(const DrawTile drawBuffer[][MAX_WIDTH], const DrawTile prevDrawBuffer[
 }
 
 // draw status
-void draw_status(const Dungeon *dungeon)
+void draw_status(const Game *game, const Dungeon *dungeon)
 {
     // clear status area
     for (int y = 0; y < MAX_MESSAGES; ++y)
     {
-        move(MAX_HEIGHT + y, 0);
+        move(game->viewHeight + y, 0);
         clrtoeol();
     }
 
-    move(MAX_HEIGHT, 0);
+    move(game->viewHeight, 0);
 
     // re-render status area
     char *status;
@@ -221,49 +335,28 @@ void draw_status(const Dungeon *dungeon)
     addstr(status);
     sprintf(status, "Depth: %d\n", dungeon->level->depth);
     addstr(status);
-    sprintf(status, "Gold: %d\n", total_gold(dungeon->level->player->items, dungeon->level->player->itemCount));
+    sprintf(status, "Gold: %d\n", total_gold(dungeon->player->inventory->items, dungeon->player->inventory->itemCount));
     addstr(status);
 
     // re-render messages
     for (int y = 0; y < MAX_MESSAGES; ++y)
     {
-        if (get_message(y) != NULL)
+        if (get_message(game, y) != NULL)
         {
-            mvaddstr(y + MAX_HEIGHT, MAX_WIDTH / 2, get_message(y));
+            mvaddstr(y + game->viewHeight, game->viewWidth / 2, get_message(game, y));
         }
     }
 
     refresh();
 }
 
-void print_mob_list(RL_Heap *mobs)
+void print_mob_list(const KillStats *kills)
 {
-    if (mobs == NULL) return;
-    int mobCount = rl_heap_length(mobs);
-    char mobsIndexed[mobCount]; // array of symbols (currently symbol is mob ID)
-    int amountKilled = 0;
-
-    for (int i = 0; i < mobCount; ++i) {
-        Mob *m = mobs->heap[i];
-        if (m == NULL) return;
-
-        // ensure mob hasn't already been indexed
-        int j;
-        for (j = 0; j < mobCount; ++j) {
-            if (mobsIndexed[j] == m->symbol) break;
-        }
-        if (mobsIndexed[j] == m->symbol) continue;
-
-        // count mobs
-        amountKilled = 0;
-        for (j = 0; j < mobCount; ++j) {
-            if (mobs->heap[j] == NULL) continue;
-            Mob *m2 = mobs->heap[j];
-            if (m2->symbol == m->symbol) ++amountKilled;
-        }
-        mobsIndexed[i] = m->symbol;
+    for (int i = 0; i < kills->speciesCount; ++i) {
+        char symbol = kills->species[i];
+        int amountKilled = kills->killed[symbol & (MOB_SYMBOLS - 1)];
 
-        const char *name = mob_name(m->symbol);
+        const char *name = mob_name(symbol);
         if (amountKilled == 1)
             printf("%d %s\n", amountKilled, name);
         else
@@ -290,10 +383,9 @@ SYMBOL get_symbol(Level *level, RL_Point coords)
     /**
      * Monster symbol
      */
-    for (int i = 0; i < MAX_MOBS; ++i)
+    const Mob *mob = get_mob(level, coords);
+    if (mob != NULL)
     {
-        const Mob *mob = get_mob(level, coords);
-        if (mob == NULL) continue;
 #ifndef DISABLE_FOV
         if (rl_fov_is_visible(level->fov, mob->coords.x, mob->coords.y))
 #endif
@@ -303,9 +395,8 @@ SYMBOL get_symbol(Level *level, RL_Point coords)
     /**
      * Item symbol
      */
-    RL_Heap *is = level->items[y][x];
-    Item *i = NULL;
-    if (is && (i = rl_heap_peek(is))) {
+    const Item *i = top_floor_item(&level->floor, x, y);
+    if (i) {
         return item_symbol(i->type);
     }
 
@@ -379,10 +470,9 @@ int get_color(Level *level, RL_Point coords)
     /**
      * Item colors
      */
-    RL_Heap *is = level->items[(int)coords.y][(int)coords.x];
     const Mob *mob = get_mob(level, coords);
-    if (mob == NULL && is) {
-        Item *i = rl_heap_peek(is);
+    if (mob == NULL) {
+        const Item *i = top_floor_item(&level->floor, coords.x, coords.y);
 
         if (i && i->type == ITEM_ARMOR) {
             switch (i->armor.material) {
@@ -3,18 +3,65 @@
 
 #include "dungeon.h"
 #include "lib/roguelike.h"
+#include <ncurses.h>
 
-// initialize our screen
-// returns 0 on success
-int init();
+#if(NCURSES_WIDECHAR)
+#define SYMBOL wchar_t
+#else
+#define SYMBOL char
+#endif
+
+// colors of DrawTile
+#define COLOR_PAIR_DEFAULT 1
+#define COLOR_PAIR_GREEN   2
+#define COLOR_PAIR_BROWN   3
+#define COLOR_PAIR_YELLOW  4
+#define COLOR_PAIR_BLACK   5
+#define COLOR_PAIR_PURPLE  6
+
+// smallest map view on screen, the status area takes another MAX_MESSAGES
+// rows below it
+#define MIN_VIEW_WIDTH  40
+#define MIN_VIEW_HEIGHT 12
+
+// tiles the camera keeps between the player & the edge of the view, when
+// the map goes on beyond it
+#define CAMERA_MARGIN 8
+
+typedef struct DrawTile {
+    SYMBOL symbol;
+    int colorPair; // for curses color
+    int attr;      // bold, etc.
+} DrawTile;
+
+// initialize our screen, color support & the view size for the terminal
+// are kept in game
+// returns 0 if the terminal is too small
+int init(Game *game, int enableColor);
 
 // end curses mode
 void deinit();
 
-// update & refresh the screen
-void render(const Dungeon *dungeon);
+// update & refresh the screen, only tiles changed since the last frame of
+// game are drawn, when the camera moves what is still in view is scrolled
+// instead
+void render(Game *game, const Dungeon *dungeon);
+
+// move the camera to follow the player & fill the screen buffer of game
+// with the map in view & menus without touching curses, i.e. for headless
+// games
+void render_frame(Game *game, const Dungeon *dungeon);
+
+// shift the top left width by height cells of frame by a camera movement
+// of dx, dy tiles, cells that scrolled in are marked so they differ from
+// any tile & are drawn again
+void scroll_frame(DrawTile frame[][MAX_WIDTH], int width, int height, int dx, int dy);
+
+// draw a recorded screen, text is the status area with a line per row
+// (see Playback)
+void render_tiles(Game *game, const DrawTile tiles[][MAX_WIDTH], const char *text);
 
 // print the killed mob list
-void print_mob_list(RL_Heap *heap);
+void print_mob_list(const KillStats *kills);
 
 #endif
@@ -1,13 +1,29 @@
 #include "dungeon.h"
+#include "game.h"
+#include "context.h"
+#include "hash.h"
+#include "save.h"
 #include <stdlib.h>
 #include <memory.h>
 #include <assert.h>
 #include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
-Dungeon *create_dungeon(unsigned long seed)
+static pthread_mutex_t mapgenLock = PTHREAD_MUTEX_INITIALIZER; // see randomly_fill_tiles
+
+// level generated on another thread, with its own copy of the game
+typedef struct Pregen_t {
+    pthread_t thread;
+    Level *level;
+    Game *game; // for the seed of split streams & the world hash of level
+} Pregen;
+
+Dungeon *create_dungeon(Game *game, unsigned long seed)
 {
     // do this otherwise initial seed will always be the same
-    init_random(seed);
+    init_random(&game->random, seed);
+    game->hash = 0;
 
     // allocate dungeon
     Dungeon *dungeon;
@@ -18,7 +34,16 @@ Dungeon *create_dungeon(unsigned long seed)
         return NULL;
 
     dungeon->turn = 0;
-    dungeon->killed = NULL;
+    dungeon->seed = seed;
+    dungeon->width = game->mapWidth;
+    dungeon->height = game->mapHeight;
+    dungeon->residentDistance = RESIDENT_DISTANCE;
+    dungeon->kills = (KillStats) {0};
+    dungeon->snapshot = NULL;
+    dungeon->snapshotSize = 0;
+    dungeon->snapshotLevels = 0;
+    dungeon->pregenerate = 0;
+    dungeon->pregen = NULL;
 
     // allocate player
     Mob *player;
@@ -34,31 +59,28 @@ Dungeon *create_dungeon(unsigned long seed)
     }
 
     // initialize player
+    *player = (Mob) {0};
     player->type = MOB_PLAYER;
     player->symbol = '@';
     player->hp = 10;
     player->maxHP = 10;
     player->minDamage = 1;
     player->maxDamage = 3;
-    player->equipment = (Equipment) {0};
-    player->attrs = (PlayerAttributes) {0};
     player->attrs.expNext = 1000;
     player->attrs.level = 1;
-    player->itemCount = 0;
-    memset(player->items, 0, MAX_INVENTORY_ITEMS*sizeof(*player->items));
 
     // give player some simple equipment
-    Item *gold = create_item(1, ITEM_GOLD);
-    Item *armor = leather();
-    Item *weapon = quarterstaff();
-    give_mob_item(player, gold);
-    if (give_mob_item(player, armor))
-        player->equipment.armor = armor;
-    if (give_mob_item(player, weapon))
-        player->equipment.weapon = weapon;
+    Item *gold = create_item(game, 1, ITEM_GOLD);
+    Item *armor = leather(game);
+    Item *weapon = quarterstaff(game);
+    give_mob_item(game, player, gold);
+    if (give_mob_item(game, player, armor))
+        player->inventory->equipment.armor = armor;
+    if (give_mob_item(game, player, weapon))
+        player->inventory->equipment.weapon = weapon;
 
     // initialize first level
-    Level *level = create_level(1);
+    Level *level = create_level(game, 1, dungeon->width, dungeon->height);
     dungeon->level = level;
 
     // handle out of memory case
@@ -82,28 +104,246 @@ int max_depth(Dungeon *dungeon)
     return cur->depth;
 }
 
-void randomly_fill_tiles(Level *level);
-void randomly_fill_mobs(Level *level, int max);
-int init_level(Level *level, Mob *player)
+Level *clone_level(Level *level, Mob *player);
+Dungeon *clone_dungeon(Game *game, Dungeon *dungeon)
+{
+    // levels still in a save snapshot have to be loaded to be copied,
+    // packed levels are copied packed
+    Level *first = dungeon->level;
+    while (first->prev)
+        first = first->prev;
+    for (Level *level = first; level; level = level->next)
+        if (level->snapshot && !load_level(game, dungeon, level))
+            return NULL;
+
+    Dungeon *clone = malloc(sizeof(Dungeon));
+    Mob *player = malloc(sizeof(Mob));
+    if (clone == NULL || player == NULL)
+    {
+        free(clone);
+        free(player);
+
+        return NULL;
+    }
+
+    *clone = *dungeon;
+    clone->snapshot = NULL;
+    clone->snapshotSize = 0;
+    clone->snapshotLevels = 0;
+    clone->pregenerate = 0;
+    clone->pregen = NULL;
+    clone->player = player;
+    clone->level = NULL;
+    if (!clone_mob(player, dungeon->player))
+    {
+        destroy_dungeon(clone);
+
+        return NULL;
+    }
+
+    Level *prev = NULL;
+    for (Level *level = first; level; level = level->next)
+    {
+        Level *copy = clone_level(level, player);
+        if (copy == NULL)
+        {
+            destroy_dungeon(clone);
+
+            return NULL;
+        }
+
+        copy->prev = prev;
+        if (prev)
+            prev->next = copy;
+        prev = copy;
+
+        // point at a copied level even if cloning fails before the current one
+        if (clone->level == NULL || level == dungeon->level)
+            clone->level = copy;
+    }
+
+    return clone;
+}
+
+void destroy_dungeon(Dungeon *dungeon)
+{
+    Pregen *pregen = dungeon->pregen;
+    if (pregen)
+    {
+        pthread_join(pregen->thread, NULL);
+        destroy_level(pregen->level);
+        destroy_game(pregen->game);
+        free(pregen);
+    }
+
+    Level *level = dungeon->level;
+    while (level && level->prev)
+        level = level->prev;
+    while (level)
+    {
+        Level *next = level->next;
+        destroy_level(level);
+        level = next;
+    }
+
+    Inventory *inventory = dungeon->player->inventory;
+    for (int i = 0; inventory && i < inventory->itemCount; ++i)
+        free(inventory->items[i]);
+    destroy_mob(dungeon->player);
+    free(dungeon->player);
+
+    // levels that were never loaded from the save
+    if (dungeon->snapshot)
+        munmap(dungeon->snapshot, dungeon->snapshotSize);
+    free(dungeon);
+}
+
+void destroy_level(Level *level)
+{
+    clear_level(level);
+    free(level->packed);
+    forget_autosave(level);
+    destroy_arena(level->arena);
+}
+
+void clear_level(Level *level)
+{
+    for (int i = 0; i < level->mobCount; ++i)
+    {
+        Inventory *inventory = level->mobs[i].inventory;
+        for (int j = 0; inventory && j < inventory->itemCount; ++j)
+            free(inventory->items[j]);
+        destroy_mob(&level->mobs[i]);
+    }
+    memset(level->mobs, 0, sizeof(level->mobs));
+    level->mobCount = 0;
+
+    // only the last level sharing the map frees it
+    if (level->mapRefs == NULL || atomic_fetch_sub(level->mapRefs, 1) == 1)
+    {
+        if (level->map)
+            rl_map_destroy(level->map);
+        free(level->mapRefs);
+    }
+    level->map = NULL;
+    level->mapRefs = NULL;
+
+    if (level->fov)
+        rl_fov_destroy(level->fov);
+    if (level->fovMap)
+        rl_map_destroy(level->fovMap);
+    if (level->fovWindow)
+        rl_fov_destroy(level->fovWindow);
+    level->fov = NULL;
+    level->fovMap = NULL;
+    level->fovWindow = NULL;
+    level->fovCenter = RL_XY(-1, -1);
+
+    // tile sets & floor items are in the arena, the level is its first block
+    level->passable = (TileSet) {0};
+    level->rooms = (TileSet) {0};
+    level->floor = (FloorItems) {0};
+    arena_clear(level->arena, sizeof(Level));
+}
+
+size_t level_bytes(const Level *level)
+{
+    size_t bytes = arena_size(level->arena) + level->packedSize;
+    if (level->map)
+        bytes += sizeof(RL_Map) + level->map->width * level->map->height;
+    if (level->fov)
+        bytes += sizeof(RL_FOV) + level->fov->width * level->fov->height;
+
+    return bytes;
+}
+
+void own_map(Level *level)
+{
+    if (level->mapRefs == NULL)
+        return;
+
+    // last level sharing the map can keep it
+    if (atomic_fetch_sub(level->mapRefs, 1) == 1)
+        free(level->mapRefs);
+    else
+    {
+        RL_Map *map = rl_map_create(level->map->width, level->map->height);
+        assert(map);
+        for (unsigned int y = 0; y < map->height; ++y)
+            for (unsigned int x = 0; x < map->width; ++x)
+                *rl_map_tile(map, x, y) = *rl_map_tile(level->map, x, y);
+        level->map = map;
+    }
+
+    level->mapRefs = NULL;
+}
+
+void generate_level(Game *game, Level *level);
+int init_level(Game *game, Level *level, Mob *player)
 {
     if (level == NULL)
         // simple error case
         return 0;
 
-    level->player = player;
-
-    // randomly generate map
-    randomly_fill_tiles(level);
+    if (level->map == NULL)
+        generate_level(game, level);
 
     // place player on upstair
+    level->player = player;
     player->coords = level->upstair_loc;
 
-    // randomly populate *new* levels with max of MAX_MOBS / 2
-    randomly_fill_mobs(level, MAX_MOBS / 2);
-
     return 1;
 }
 
+void *run_pregen(void *arg);
+void pregenerate_level(Game *game, Dungeon *dungeon)
+{
+    Level *level = dungeon->level;
+    if (!dungeon->pregenerate || dungeon->pregen || level->next || level->depth == MAX_LEVEL)
+        return;
+
+    Pregen *pregen = malloc(sizeof(Pregen));
+    if (pregen == NULL)
+        return;
+
+    // stream of the level is split here, the copy of the game gives the
+    // thread the seed for the mob streams & a world hash of its own
+    pregen->level = create_level(game, level->depth + 1, dungeon->width, dungeon->height);
+    pregen->game = clone_game(game);
+    if (pregen->game)
+        pregen->game->hash = 0;
+    if (pregen->level == NULL || pregen->game == NULL ||
+            pthread_create(&pregen->thread, NULL, run_pregen, pregen) != 0)
+    {
+        // generated once the player gets there instead
+        if (pregen->level)
+            destroy_level(pregen->level);
+        destroy_game(pregen->game);
+        free(pregen);
+
+        return;
+    }
+
+    dungeon->pregen = pregen;
+}
+
+Level *take_pregenerated_level(Game *game, Dungeon *dungeon)
+{
+    Pregen *pregen = dungeon->pregen;
+    if (pregen == NULL)
+        return NULL;
+
+    pthread_join(pregen->thread, NULL);
+    game->hash ^= pregen->game->hash;
+
+    Level *level = pregen->level;
+    destroy_game(pregen->game);
+    free(pregen);
+    dungeon->pregen = NULL;
+
+    return level;
+}
+
 /*************/
 /**         **/
 /** private **/
@@ -112,93 +352,158 @@ int init_level(Level *level, Mob *player)
 
 // dungeon generation stuff
 
-void randomly_fill_tiles(Level *level)
+void randomly_fill_tiles(Game *game, Level *level);
+void randomly_fill_mobs(Game *game, Level *level, int max);
+void generate_level(Game *game, Level *level)
+{
+    // randomly generate map
+    randomly_fill_tiles(game, level);
+
+    // randomly populate *new* levels with max of MAX_MOBS / 2
+    randomly_fill_mobs(game, level, MAX_MOBS / 2);
+}
+
+void *run_pregen(void *arg)
+{
+    Pregen *pregen = arg;
+    generate_level(pregen->game, pregen->level);
+
+    return NULL;
+}
+
+void randomly_fill_tiles(Game *game, Level *level)
 {
     if (level == NULL) return;
-    level->map = rl_map_create(MAX_WIDTH, MAX_HEIGHT);
+    level->map = rl_map_create(level->width, level->height);
     assert(level->map);
+    // mapgen rolls with rand(), which every thread shares - seed & generate
+    // under a lock so each map only depends on its level stream
+    pthread_mutex_lock(&mapgenLock);
+    srand(next_random(&level->rng));
     rl_mapgen_bsp(level->map, RL_MAPGEN_BSP_DEFAULTS);
-    level->fov = rl_fov_create(MAX_WIDTH, MAX_HEIGHT);
+    pthread_mutex_unlock(&mapgenLock);
+    level->fov = rl_fov_create(level->width, level->height);
+    int indexed = index_tiles(level);
+    assert(indexed);
 
     // randomly place upstairs
-    RL_Point up;
-    int i = 0;
-    while (i < MAX_RANDOM_RECURSION) {
-        up = random_passable_coords(level);
-        if (rl_map_tile_is(level->map, up.x, up.y, RL_TileRoom)) {
-            level->upstair_loc = up;
-            break;
-        }
-    }
-    assert(i < MAX_RANDOM_RECURSION);
-    assert(rl_map_tile_is(level->map, level->upstair_loc.x, level->upstair_loc.y, RL_TileRoom));
+    int placed = random_free_coords(level, &level->rooms, FREE_ANY, &level->rng, &level->upstair_loc);
+    assert(placed);
 
     // randomly place downstairs
     // TODO place downstairs at greater distance from upstairs
     // TODO once win condition is defined, don't place downstairs on last level
-    RL_Point down;
-    i = 0;
-    while (i < MAX_RANDOM_RECURSION) {
-        down = random_passable_coords(level);
-        if (rl_map_tile_is(level->map, down.x, down.y, RL_TileRoom) &&
-                !(level->upstair_loc.x == down.x && level->upstair_loc.y == down.y)) {
-            level->downstair_loc = down;
-            break;
-        }
-    }
-    assert(i < MAX_RANDOM_RECURSION);
-    assert(rl_map_tile_is(level->map, level->downstair_loc.x, level->downstair_loc.y, RL_TileRoom));
+    placed = random_free_coords(level, &level->rooms, FREE_NO_STAIRS, &level->rng, &level->downstair_loc);
+    assert(placed);
+
+    hash_map(game, level);
 }
 
-void randomly_fill_mobs(Level *level, int max)
+void randomly_fill_mobs(Game *game, Level *level, int max)
 {
-    Mob **mobs = level->mobs;
-
-    int amount = generate(0, max);
+    int amount = generate(&level->rng, 0, max);
     for (int i = 0; i < amount; ++i)
     {
-        RL_Point coords = random_passable_coords(level);
-        Mob *mob = create_mob(level->depth, coords);
-
-        if (mob == NULL)
-            return;
-
         // don't spawn mobs on stairs
-        while ((level->upstair_loc.x == coords.x && level->upstair_loc.y == coords.y) ||
-                (level->downstair_loc.x == coords.x && level->downstair_loc.y == coords.y))
-        {
-            coords = random_passable_coords(level);
-        }
+        RL_Point coords;
+        if (!random_free_coords(level, &level->passable, FREE_NO_STAIRS, &level->rng, &coords))
+            break;
 
-        insert_mob(mob, mobs);
+        insert_mob(game, create_mob(game, level->depth, coords, &level->rng), level->mobs, &level->mobCount);
     }
 }
 
-RL_Point random_coords(Level *level)
+RL_Point random_coords(Level *level, RL_Point center, int radius, RNG *rng)
 {
+    int x = center.x, y = center.y;
     RL_Point coords;
-    coords.x = generate(0, level->map->width - 1);
-    coords.y = generate(0, level->map->height - 1);
+    coords.x = generate(rng, x > radius ? x - radius : 0, x + radius < (int) level->width ? x + radius : (int) level->width - 1);
+    coords.y = generate(rng, y > radius ? y - radius : 0, y + radius < (int) level->height ? y + radius : (int) level->height - 1);
 
     return coords;
 }
 
-Mob *get_mob(const Level *level, RL_Point coords);
-RL_Point random_passable_coords(Level *level)
+void update_fov(Level *level)
+{
+    RL_Point center = level->player->coords;
+
+    // the FOV is calculated in a window around the player instead of the
+    // whole map, which would touch every tile each turn
+    int size = 2 * (FOV_RADIUS + 1) + 1;
+    if (level->fovMap == NULL)
+    {
+        level->fovMap = rl_map_create(size, size);
+        level->fovWindow = rl_fov_create(size, size);
+        assert(level->fovMap && level->fovWindow);
+    }
+
+    // what was visible is now only seen, tiles were only visible around
+    // the last center (unknown after loading)
+    if (level->fovCenter.x < 0)
+    {
+        for (unsigned int i = 0; i < level->width * level->height; ++i)
+            if (level->fov->visibility[i] == RL_TileVisible)
+                level->fov->visibility[i] = RL_TileSeen;
+    }
+    else
+    {
+        for (int y = level->fovCenter.y - FOV_RADIUS; y <= level->fovCenter.y + FOV_RADIUS; ++y)
+            for (int x = level->fovCenter.x - FOV_RADIUS; x <= level->fovCenter.x + FOV_RADIUS; ++x)
+                if (x >= 0 && y >= 0 && x < (int) level->width && y < (int) level->height &&
+                        level->fov->visibility[y * level->width + x] == RL_TileVisible)
+                    level->fov->visibility[y * level->width + x] = RL_TileSeen;
+    }
+
+    // copy the tiles around center, outside of the map is rock
+    int left = center.x - FOV_RADIUS - 1, top = center.y - FOV_RADIUS - 1;
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+            *rl_map_tile(level->fovMap, x, y) = rl_map_in_bounds(level->map, left + x, top + y) ?
+                *rl_map_tile(level->map, left + x, top + y) : RL_TileRock;
+
+    rl_fov_calculate(level->fovWindow, level->fovMap, center.x - left, center.y - top, FOV_RADIUS);
+    for (int y = 0; y < size; ++y)
+        for (int x = 0; x < size; ++x)
+            if (rl_fov_is_visible(level->fovWindow, x, y) && rl_map_in_bounds(level->map, left + x, top + y))
+                level->fov->visibility[(top + y) * level->width + left + x] = RL_TileVisible;
+
+    level->fovCenter = center;
+}
+
+int index_tiles(Level *level)
+{
+    return init_tile_set(&level->passable, level->map, 0, level->arena) &&
+        init_tile_set(&level->rooms, level->map, 1, level->arena);
+}
+
+int random_free_coords(Level *level, TileSet *set, int exclude, RNG *rng, RL_Point *coords)
 {
-    // do simple brute force attempt to get a passable coord
-    int i = 0;
-    while (i < MAX_RANDOM_RECURSION)
+    // exclude what's taken, at most MAX_MOBS + 1 tiles
+    if (level->player)
+        exclude_tile(set, level->player->coords.x, level->player->coords.y);
+    for (int i = 0; i < level->mobCount; ++i)
+        exclude_tile(set, level->mobs[i].coords.x, level->mobs[i].coords.y);
+
+    if (exclude & FREE_NO_STAIRS)
+    {
+        exclude_tile(set, level->upstair_loc.x, level->upstair_loc.y);
+        exclude_tile(set, level->downstair_loc.x, level->downstair_loc.y);
+    }
+
+    // only tiles in FOV radius of the player can be visible
+    if ((exclude & FREE_HIDDEN) && level->player && level->fov)
     {
-        RL_Point coords = random_coords(level);
-        Mob *m = get_mob(level, coords);
-        if (rl_map_is_passable(level->map, coords.x, coords.y) && m == NULL)
-            return coords;
-        ++i;
+        RL_Point center = level->player->coords;
+        for (int y = center.y - FOV_RADIUS; y <= center.y + FOV_RADIUS; ++y)
+            for (int x = center.x - FOV_RADIUS; x <= center.x + FOV_RADIUS; ++x)
+                if (x >= 0 && y >= 0 && rl_fov_is_visible(level->fov, x, y))
+                    exclude_tile(set, x, y);
     }
-    assert(i < MAX_RANDOM_RECURSION);
 
-    return RL_XY(MAX_WIDTH, MAX_HEIGHT);
+    int found = pick_tile(set, rng, coords);
+    restore_tiles(set);
+
+    return found;
 }
 
 /*************/
@@ -207,46 +512,192 @@ RL_Point random_passable_coords(Level *level)
 /**         **/
 /*************/
 
-Level *create_level(int depth)
+Level *create_level(Game *game, int depth, unsigned int width, unsigned int height)
 {
-    Level *level;
-    level = malloc(sizeof(Level));
+    // level lives in its own arena
+    Arena *arena = create_arena();
+    Level *level = arena ? arena_alloc(arena, sizeof(Level)) : NULL;
 
     // check for OOM
     if (level == NULL)
+    {
+        destroy_arena(arena);
+
         return NULL;
+    }
+    level->arena = arena;
 
     // initialize mobs
-    for (int i = 0; i < MAX_MOBS; ++i) level->mobs[i] = NULL;
+    memset(level->mobs, 0, sizeof(level->mobs));
+    level->mobCount = 0;
 
-    // initialize depth
+    // initialize depth, each depth has its own stream so levels come out
+    // the same no matter when they're generated
     level->depth = depth;
+    level->rng = split_stream(game->random.seed, RNG_LEVEL, depth);
 
     // initialize vars to null
     level->next = NULL;
     level->prev = NULL;
+    level->width = width;
+    level->height = height;
+    level->map = NULL;
+    level->mapRefs = NULL;
+    level->fov = NULL;
+    level->fovCenter = RL_XY(-1, -1);
+    level->fovMap = NULL;
+    level->fovWindow = NULL;
+    level->passable = (TileSet) {0};
+    level->rooms = (TileSet) {0};
+    level->upstair_loc = RL_XY(-1, -1);
+    level->downstair_loc = RL_XY(-1, -1);
+    level->leftTurn = -1;
+    level->player = NULL;
+    level->snapshot = NULL;
+    level->packed = NULL;
+    level->packedSize = 0;
+    level->packedHash = 0;
+    level->autosave = NULL;
+    level->dirty = 1;
 
     // initialize items
-    for (int y=0; y<MAX_HEIGHT; ++y) {
-        for (int x=0; x<MAX_WIDTH; ++x) {
-            level->items[y][x] = NULL;
-        }
+    if (!init_floor(&level->floor, width, height, arena))
+    {
+        destroy_arena(arena);
+
+        return NULL;
     }
 
     return level;
 }
 
+// copy level, the map is shared with the copy
+// returns NULL on OOM
+Level *clone_level(Level *level, Mob *player)
+{
+    Arena *arena = create_arena();
+    Level *clone = arena ? arena_alloc(arena, sizeof(Level)) : NULL;
+    if (clone == NULL)
+    {
+        destroy_arena(arena);
+
+        return NULL;
+    }
+
+    *clone = *level;
+    clone->arena = arena;
+    clone->player = player;
+    clone->prev = NULL;
+    clone->next = NULL;
+    clone->snapshot = NULL;
+    clone->autosave = NULL;
+    clone->dirty = 1;
+
+    // clear everything destroy_level frees until it has been copied
+    clone->mobCount = 0;
+    clone->fov = NULL;
+    clone->fovMap = NULL;
+    clone->fovWindow = NULL;
+    clone->passable = (TileSet) {0};
+    clone->rooms = (TileSet) {0};
+    clone->floor = (FloorItems) {0};
+    clone->packed = NULL;
+    clone->packedSize = 0;
+
+    if (level->packed)
+    {
+        clone->packed = malloc(level->packedSize);
+        if (clone->packed == NULL)
+        {
+            destroy_level(clone);
+
+            return NULL;
+        }
+        memcpy(clone->packed, level->packed, level->packedSize);
+        clone->packedSize = level->packedSize;
+
+        return clone;
+    }
+
+    if (level->mapRefs == NULL && level->map)
+    {
+        level->mapRefs = malloc(sizeof(atomic_int));
+        if (level->mapRefs == NULL)
+        {
+            clone->map = NULL;
+            destroy_level(clone);
+
+            return NULL;
+        }
+        atomic_init(level->mapRefs, 1);
+    }
+    if (level->mapRefs)
+        atomic_fetch_add(level->mapRefs, 1);
+    clone->mapRefs = level->mapRefs;
+
+    if (level->fov)
+    {
+        clone->fov = rl_fov_create(level->fov->width, level->fov->height);
+        if (clone->fov == NULL)
+        {
+            destroy_level(clone);
+
+            return NULL;
+        }
+        memcpy(clone->fov->visibility, level->fov->visibility, level->fov->width * level->fov->height);
+    }
+
+    if (level->passable.tiles &&
+            (!copy_tile_set(&clone->passable, &level->passable, arena) ||
+             !copy_tile_set(&clone->rooms, &level->rooms, arena)))
+    {
+        destroy_level(clone);
+
+        return NULL;
+    }
+
+    for (int i = 0; i < level->mobCount; ++i)
+    {
+        int ok = clone_mob(&clone->mobs[i], &level->mobs[i]);
+        clone->mobCount = i + 1;
+        if (!ok)
+        {
+            destroy_level(clone);
+
+            return NULL;
+        }
+    }
+
+    if (!copy_floor(&clone->floor, &level->floor, arena))
+    {
+        destroy_level(clone);
+
+        return NULL;
+    }
+
+    return clone;
+}
+
+void record_kill(KillStats *kills, const Mob *mob, int exp)
+{
+    int symbol = mob->symbol & (MOB_SYMBOLS - 1);
+
+    if (kills->killed[symbol]++ == 0)
+        kills->species[kills->speciesCount++] = mob->symbol;
+
+    ++kills->total;
+    kills->exp += exp;
+}
+
 Mob *get_enemy(const Level *level, RL_Point coords)
 {
-    if (coords.y >= MAX_HEIGHT || coords.x >= MAX_WIDTH || coords.y < 0 || coords.x < 0)
+    if (coords.y >= level->height || coords.x >= level->width || coords.y < 0 || coords.x < 0)
         return NULL;
 
-    for (int i = 0; i < MAX_MOBS; ++i)
+    for (int i = 0; i < level->mobCount; ++i)
     {
-        if (level->mobs[i] == NULL)
-            continue;
-        if (level->mobs[i]->coords.x == coords.x && level->mobs[i]->coords.y == coords.y) {
-            return level->mobs[i];
+        if (level->mobs[i].coords.x == coords.x && level->mobs[i].coords.y == coords.y) {
+            return (Mob*) &level->mobs[i];
         }
     }
 
@@ -255,7 +706,7 @@ Mob *get_enemy(const Level *level, RL_Point coords)
 
 Mob *get_mob(const Level *level, RL_Point coords)
 {
-    if (coords.y >= MAX_HEIGHT || coords.x >= MAX_WIDTH || coords.y < 0 || coords.x < 0)
+    if (coords.y >= level->height || coords.x >= level->width || coords.y < 0 || coords.x < 0)
         return NULL;
 
     if (level->player != NULL)
@@ -267,7 +718,7 @@ Mob *get_mob(const Level *level, RL_Point coords)
     return get_enemy(level, coords);
 }
 
-int move_mob(Mob *mob, RL_Point coords, Level *level)
+int move_mob(Game *game, Mob *mob, RL_Point coords, Level *level)
 {
     if (mob == NULL)
         return 0;
@@ -280,11 +731,36 @@ int move_mob(Mob *mob, RL_Point coords, Level *level)
 
     if (rl_map_is_passable(level->map, coords.x, coords.y))
     {
+        hash_mob(game, mob);
         mob->coords.x = coords.x;
         mob->coords.y = coords.y;
+        hash_mob(game, mob);
 
         return 1;
     }
     else
         return 0;
 }
+
+void drop_item(Game *game, Level *level, RL_Point coords, Item *item)
+{
+    Item *copy = push_floor_item(&level->floor, coords.x, coords.y, item, level->arena);
+    assert(copy);
+    free(item);
+
+    hash_floor_item(game, level, coords, copy);
+}
+
+Item *pick_up_item(Game *game, Level *level, RL_Point coords)
+{
+    Item *top = top_floor_item(&level->floor, coords.x, coords.y);
+    if (top == NULL)
+        return NULL;
+
+    hash_floor_item(game, level, coords, top);
+    Item *item = malloc(sizeof(Item));
+    assert(item);
+    pop_floor_item(&level->floor, coords.x, coords.y, item, level->arena);
+
+    return item;
+}
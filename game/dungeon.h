@@ -3,45 +3,100 @@
 
 // map constants
 #define MAX_LEVEL  10
-#define MAX_WIDTH  80
+#define MAX_WIDTH  80 // default level size & size of the map on screen
 #define MAX_HEIGHT 30
+#define MIN_MAP_SIZE 20   // smallest & biggest level width & height
+#define MAX_MAP_SIZE 4096
 
 // for dungeon generator
 #define MIN_CELLS 8
 #define MAX_CELLS 12
-#define MAX_RANDOM_RECURSION 1000
+
+// what random_free_coords skips besides tiles with a mob
+#define FREE_ANY       0
+#define FREE_NO_STAIRS 1
+#define FREE_HIDDEN    2 // not visible to the player
 
 #define FOV_RAIDUS 8
 #define MOB_ALERT_RADIUS FOV_RADIUS/2
+#define MOB_WANDER_RADIUS MAX_WIDTH // how far away mobs pick tiles to walk to
+
+// levels further than this many steps from the player are packed (see
+// pack_level) until they're entered again
+#define RESIDENT_DISTANCE 1
 
 // macro helper
 #define DIRECTION(x, y) (Direction) {x, y}
 
+#include "arena.h"
+#include "floor.h"
 #include "random.h"
+#include "tiles.h"
+#include <stdatomic.h>
+#include <stdint.h>
 
 #include "item.h"
 #include "mob.h"
 #include "lib/roguelike.h"
 
 typedef struct Level_t {
+    Arena *arena; // level, tile sets & floor items, freed with the level
     Mob *player;
-    Mob *mobs[MAX_MOBS];
+    Mob mobs[MAX_MOBS]; // packed, only first mobCount are alive
+    int mobCount;
+    unsigned int width, height; // map size
     RL_Map *map;
+    atomic_int *mapRefs; // levels sharing map (see clone_dungeon), NULL if map isn't shared
     RL_FOV *fov;
-    RL_Heap *items[MAX_HEIGHT][MAX_WIDTH]; // game-specific tile data (items, mob, etc.)
+    RL_Point fovCenter; // where update_fov last looked from, -1 if unknown
+    RL_Map *fovMap; // scratch window around the player for update_fov
+    RL_FOV *fovWindow;
+    TileSet passable; // for random_free_coords
+    TileSet rooms;
+    FloorItems floor; // items lying on the map
 
     int depth;
+    RNG rng; // level stream, for generation & spawns
     struct Level_t *prev;
     struct Level_t *next;
     RL_Point upstair_loc;
     RL_Point downstair_loc;
+    int leftTurn; // turn the player left, -1 while on the level (see catch_up_level)
+    const unsigned char *snapshot; // saved level data not yet loaded (see load_level)
+    unsigned char *packed; // compressed level data while it's packed (see pack_level), NULL if resident
+    size_t packedSize;
+    uint64_t packedHash; // what the level adds to the world hash while packed
+    struct SaveBlob_t *autosave; // level data written by last autosave
+    int dirty; // 1 if level changed since last autosave
 } Level;
 
+// aggregate stats of mobs the player has killed
+typedef struct {
+    int total;
+    int exp; // exp rewarded for kills
+    int killed[MOB_SYMBOLS]; // kills per mob symbol
+    char species[MOB_SYMBOLS]; // killed symbols in order of first kill
+    int speciesCount;
+} KillStats;
+
 typedef struct {
     Mob *player;
     Level *level;
     int turn; // turn number
-    RL_Heap *killed; // mobs player has killed
+    unsigned long seed;
+    unsigned int width, height; // size of new levels
+    int residentDistance; // levels further from the player are packed, -1 keeps them all in memory
+    KillStats kills; // mobs player has killed
+
+    // mapped save file, until every level has been loaded from it
+    void *snapshot;
+    size_t snapshotSize;
+    int snapshotLevels;
+
+    // level below the deepest one, being generated in the background
+    // before the player gets there (see pregenerate_level)
+    int pregenerate; // 1 if enabled
+    struct Pregen_t *pregen; // NULL if not started
 } Dungeon;
 
 typedef struct {
@@ -49,27 +104,86 @@ typedef struct {
     int ydir;
 } Direction;
 
-// create a new dungeon (once per game)
+// create a new dungeon (once per game), seeds the RNG streams of game &
+// resets its world hash, the player's starting items get IDs from game &
+// levels are the map size of game
 // returns NULL if there was any issues allocating memory for
 // dungeon members
-Dungeon *create_dungeon(unsigned long seed);
+Dungeon *create_dungeon(Game *game, unsigned long seed);
+
+Level *create_level(Game *game, int depth, unsigned int width, unsigned int height);
+
+// copy dungeon, i.e. to simulate turns without changing the original
+// level maps & mob paths are shared until either side changes them, levels
+// still in a save snapshot are loaded into game first (see clone_game for
+// item IDs, RNG streams & the world hash)
+// returns NULL on OOM
+Dungeon *clone_dungeon(Game *game, Dungeon *dungeon);
+
+// free dungeon, its levels & every item in them
+void destroy_dungeon(Dungeon *dungeon);
+
+// free level & every item in it (mobs & floor), the arena as well as the
+// map, FOV, mob inventories & paths that are allocated on their own
+void destroy_level(Level *level);
+
+// free everything of level but the level itself, its links & where the
+// stairs are, i.e. once it's been packed
+void clear_level(Level *level);
 
-Level *create_level(int depth);
+// bytes of memory level uses for its arena, map, FOV & packed data (mob
+// inventories & paths aren't counted)
+size_t level_bytes(const Level *level);
+
+// copy level map if it is shared with a clone, call before changing tiles
+void own_map(Level *level);
 
 // get max dungeon depth
 int max_depth(Dungeon *dungeon);
 
-// initialize random dungeon
-int init_level(Level *level, Mob *player);
+// initialize random dungeon & place player on the upstair, levels from
+// take_pregenerated_level are already generated
+int init_level(Game *game, Level *level, Mob *player);
+
+// start generating the next level on another thread if the player is on the
+// deepest level, it comes out the same as init_level would make it
+void pregenerate_level(Game *game, Dungeon *dungeon);
+
+// wait for the level pregenerate_level started & add it to the world hash
+// of game
+// returns NULL if none was started
+Level *take_pregenerated_level(Game *game, Dungeon *dungeon);
+
+// index the passable & room tiles of the level map once it is generated
+// or loaded
+// returns 0 on OOM
+int index_tiles(Level *level);
 
-// return random coordinates that are passable and do not have a mob
-RL_Point random_passable_coords(Level *level);
+// pick random coordinates of a tile in set (passable or rooms of level)
+// that doesn't have a mob & isn't skipped by exclude (FREE consts), the cost
+// doesn't depend on how many tiles are taken
+// returns 0 if there are none
+int random_free_coords(Level *level, TileSet *set, int exclude, RNG *rng, RL_Point *coords);
 
-// return random coordinates
-RL_Point random_coords(Level *level);
+// return random coordinates at most radius tiles away from center
+RL_Point random_coords(Level *level, RL_Point center, int radius, RNG *rng);
+
+// update the FOV of level around the player, only tiles in FOV_RADIUS
+// of where the player was & is are touched
+void update_fov(Level *level);
+
+// count mob as killed by the player
+void record_kill(KillStats *kills, const Mob *mob, int exp);
 
 Mob *get_mob(const Level *level, RL_Point coords);
 Mob *get_enemy(const Level *level, RL_Point coords);
-int move_mob(Mob *mob, RL_Point coords, Level *level);
+int move_mob(Game *game, Mob *mob, RL_Point coords, Level *level);
+
+// put item on floor tile, the floor keeps a copy & item is freed
+void drop_item(Game *game, Level *level, RL_Point coords, Item *item);
+
+// take top item from floor tile, NULL if there are none
+// returns a copy the caller owns
+Item *pick_up_item(Game *game, Level *level, RL_Point coords);
 
 #endif
@@ -0,0 +1,150 @@
+#include "floor.h"
+#include <string.h>
+
+int init_floor(FloorItems *floor, unsigned int width, unsigned int height, Arena *arena)
+{
+    *floor = (FloorItems) {0};
+    floor->width = width;
+    floor->height = height;
+    floor->occupied = arena_calloc(arena, (width * height + 63) / 64 * sizeof(uint64_t));
+
+    return floor->occupied != NULL;
+}
+
+int copy_floor(FloorItems *copy, const FloorItems *floor, Arena *arena)
+{
+    size_t words = (floor->width * floor->height + 63) / 64;
+    *copy = *floor;
+    copy->capacity = floor->count;
+    copy->occupied = arena_alloc(arena, words * sizeof(uint64_t));
+    copy->stacks = floor->count ? arena_alloc(arena, floor->count * sizeof(FloorStack)) : NULL;
+    if (copy->occupied == NULL || (floor->count && copy->stacks == NULL))
+        return 0;
+
+    memcpy(copy->occupied, floor->occupied, words * sizeof(uint64_t));
+    for (int i = 0; i < floor->count; ++i)
+    {
+        const FloorStack *stack = &floor->stacks[i];
+        copy->stacks[i] = *stack;
+        copy->stacks[i].capacity = stack->count;
+        copy->stacks[i].items = arena_alloc(arena, stack->count * sizeof(Item));
+        if (copy->stacks[i].items == NULL)
+            return 0;
+        memcpy(copy->stacks[i].items, stack->items, stack->count * sizeof(Item));
+    }
+
+    return 1;
+}
+
+int find_floor_stack(const FloorItems *floor, int tile);
+FloorStack *floor_stack(const FloorItems *floor, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= (int) floor->width || y >= (int) floor->height)
+        return NULL;
+
+    int tile = y * floor->width + x;
+    if (!(floor->occupied[tile / 64] & (1ULL << (tile % 64))))
+        return NULL;
+
+    return &floor->stacks[find_floor_stack(floor, tile)];
+}
+
+Item *top_floor_item(const FloorItems *floor, int x, int y)
+{
+    FloorStack *stack = floor_stack(floor, x, y);
+
+    return stack ? &stack->items[stack->count - 1] : NULL;
+}
+
+Item *push_floor_item(FloorItems *floor, int x, int y, const Item *item, Arena *arena)
+{
+    if (x < 0 || y < 0 || x >= (int) floor->width || y >= (int) floor->height)
+        return NULL;
+
+    int tile = y * floor->width + x;
+    int i = find_floor_stack(floor, tile);
+    if (i == floor->count || floor->stacks[i].tile != tile)
+    {
+        // new stack, keep them sorted
+        if (floor->count == floor->capacity)
+        {
+            int capacity = floor->capacity ? floor->capacity * 2 : 8;
+            FloorStack *stacks = arena_alloc(arena, capacity * sizeof(FloorStack));
+            if (stacks == NULL)
+                return NULL;
+
+            if (floor->count)
+                memcpy(stacks, floor->stacks, floor->count * sizeof(FloorStack));
+            arena_free(arena, floor->stacks, floor->capacity * sizeof(FloorStack));
+            floor->stacks = stacks;
+            floor->capacity = capacity;
+        }
+
+        memmove(&floor->stacks[i + 1], &floor->stacks[i], (floor->count - i) * sizeof(FloorStack));
+        floor->stacks[i] = (FloorStack) { tile, 0, 0, NULL };
+        floor->occupied[tile / 64] |= 1ULL << (tile % 64);
+        ++floor->count;
+    }
+
+    FloorStack *stack = &floor->stacks[i];
+    if (stack->count == stack->capacity)
+    {
+        int capacity = stack->capacity ? stack->capacity * 2 : 2;
+        Item *items = arena_alloc(arena, capacity * sizeof(Item));
+        if (items == NULL)
+            return NULL;
+
+        if (stack->count)
+            memcpy(items, stack->items, stack->count * sizeof(Item));
+        arena_free(arena, stack->items, stack->capacity * sizeof(Item));
+        stack->items = items;
+        stack->capacity = capacity;
+    }
+
+    stack->items[stack->count] = *item;
+
+    return &stack->items[stack->count++];
+}
+
+int pop_floor_item(FloorItems *floor, int x, int y, Item *item, Arena *arena)
+{
+    FloorStack *stack = floor_stack(floor, x, y);
+    if (stack == NULL)
+        return 0;
+
+    *item = stack->items[--stack->count];
+
+    // drop empty stack
+    if (stack->count == 0)
+    {
+        int i = stack - floor->stacks;
+        arena_free(arena, stack->items, stack->capacity * sizeof(Item));
+        floor->occupied[stack->tile / 64] &= ~(1ULL << (stack->tile % 64));
+        memmove(&floor->stacks[i], &floor->stacks[i + 1], (floor->count - i - 1) * sizeof(FloorStack));
+        --floor->count;
+    }
+
+    return 1;
+}
+
+/*************/
+/**         **/
+/** private **/
+/**         **/
+/*************/
+
+// index of the stack of tile, or where it would go
+int find_floor_stack(const FloorItems *floor, int tile)
+{
+    int low = 0, high = floor->count;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (floor->stacks[middle].tile < tile)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
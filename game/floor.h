@@ -0,0 +1,46 @@
+#ifndef FLOOR_H
+#define FLOOR_H
+
+#include "arena.h"
+#include "item.h"
+#include <stdint.h>
+
+// Items lying on the floor of a level. Only tiles with items have a stack,
+// kept sorted by tile in one array, and a bitmap of those tiles answers
+// "is anything here" without a search. Memory comes from the level arena.
+
+// items on one tile, the top one is picked up first
+typedef struct {
+    int tile; // y * width + x
+    int count, capacity;
+    Item *items; // bottom first
+} FloorStack;
+
+typedef struct {
+    FloorStack *stacks; // by tile
+    int count, capacity;
+    uint64_t *occupied; // bit per tile with a stack
+    unsigned int width, height;
+} FloorItems;
+
+// returns 0 on OOM
+int init_floor(FloorItems *floor, unsigned int width, unsigned int height, Arena *arena);
+
+// returns 0 on OOM
+int copy_floor(FloorItems *copy, const FloorItems *floor, Arena *arena);
+
+// stack of tile, NULL if there are no items on it
+FloorStack *floor_stack(const FloorItems *floor, int x, int y);
+
+// top item of tile, NULL if there are none
+Item *top_floor_item(const FloorItems *floor, int x, int y);
+
+// put a copy of item on top of tile
+// returns the copy, NULL on OOM
+Item *push_floor_item(FloorItems *floor, int x, int y, const Item *item, Arena *arena);
+
+// take the top item of tile into item
+// returns 0 if there are none
+int pop_floor_item(FloorItems *floor, int x, int y, Item *item, Arena *arena);
+
+#endif
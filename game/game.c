@@ -1,46 +1,43 @@
 #include "game.h"
 #include "message.h"
+#include "save.h"
+#include "hash.h"
+#include "context.h"
 #include <stdlib.h>
 #include <memory.h>
 #include <ncurses.h>
 #include <assert.h>
 #include <float.h>
-
-// shortcut to push to a non-pointer
-#define RL_PUSH(heap, item) \
-    if (heap == NULL) { \
-        *(&heap) = rl_heap_create(1, NULL); \
-        assert(heap); \
-    } \
-    rl_heap_insert(heap, item);
-
-static int resting = 0; // 1 if player resting
-static int inMenu = 0; // one of MENU consts if in menu
-static Direction runDir = { 0, 0 }; // direction player is running
-
-int get_menu() { return inMenu; }
-int is_running() { return runDir.xdir != 0 || runDir.ydir != 0; }
-
-int increase_depth(Dungeon *dungeon);
-int decrease_depth(Dungeon *dungeon);
-void move_player(Mob *player, RL_Point coords, Level *level);
-void run_player(Mob *player, Direction dir, Level *level);
+#include <math.h>
+
+int get_menu(const Game *game) { return game->inMenu; }
+void set_autosave(Game *game, const char *filename) { game->autosaveFile = filename; }
+int is_running(const Game *game) { return game->runDir.xdir != 0 || game->runDir.ydir != 0; }
+
+int increase_depth(Game *game, Dungeon *dungeon);
+int decrease_depth(Game *game, Dungeon *dungeon);
+void pack_far_levels(Dungeon *dungeon);
+void catch_up_level(Game *game, Level *level, int turn);
+void move_player(Game *game, Mob *player, RL_Point coords, Level *level);
+void run_player(Game *game, Mob *player, Direction dir, Level *level);
 void tick(Dungeon *dungeon);
-void tick_mobs(Level *level);
-void cleanup(Dungeon *dungeon);
-void menu_management(int input, Level *level);
-int gameloop(Dungeon *dungeon, int input)
+void cleanup(Game *game, Dungeon *dungeon);
+void menu_management(Game *game, int input, Level *level);
+int gameloop(Game *game, Dungeon *dungeon, int input)
 {
     Level *level = dungeon->level;
     Mob *player = dungeon->player;
 
-    if (inMenu)
+    // get the next level ready while the player explores this one
+    pregenerate_level(game, dungeon);
+
+    if (game->inMenu)
     {
-        menu_management(input, level);
+        menu_management(game, input, level);
         input = '.'; // do nothing
     }
 
-    if (resting || is_running())
+    if (game->resting || is_running(game))
         input = '.'; // do nothing
 
     switch (input)
@@ -48,45 +45,48 @@ int gameloop(Dungeon *dungeon, int input)
         case 'Q':
             return GAME_QUIT;
 
+        case 'S':
+            return GAME_SAVE;
+
         case KEY_LEFT:
         case 'h':
-            move_player(player, RL_XY(player->coords.x - 1, player->coords.y), level);
+            move_player(game, player, RL_XY(player->coords.x - 1, player->coords.y), level);
             break;
         case KEY_RIGHT:
         case 'l':
-            move_player(player, RL_XY(player->coords.x + 1, player->coords.y), level);
+            move_player(game, player, RL_XY(player->coords.x + 1, player->coords.y), level);
             break;
         case KEY_DOWN:
         case 'j':
-            move_player(player, RL_XY(player->coords.x, player->coords.y + 1), level);
+            move_player(game, player, RL_XY(player->coords.x, player->coords.y + 1), level);
             break;
         case KEY_UP:
         case 'k':
-            move_player(player, RL_XY(player->coords.x, player->coords.y - 1), level);
+            move_player(game, player, RL_XY(player->coords.x, player->coords.y - 1), level);
             break;
 
         case 'H':
-            run_player(player, DIRECTION(-1, 0), level);
+            run_player(game, player, DIRECTION(-1, 0), level);
             break;
         case 'L':
-            run_player(player, DIRECTION(1, 0), level);
+            run_player(game, player, DIRECTION(1, 0), level);
             break;
         case 'J':
-            run_player(player, DIRECTION(0, 1), level);
+            run_player(game, player, DIRECTION(0, 1), level);
             break;
         case 'K':
-            run_player(player, DIRECTION(0, -1), level);
+            run_player(game, player, DIRECTION(0, -1), level);
             break;
 
         case ',':
         case 'g':
             // get all items from floor
             Item *item;
-            while ((item = rl_heap_pop(level->items[(int)player->coords.y][(int)player->coords.x])))
+            while ((item = pick_up_item(game, level, player->coords)))
             {
-                if (!give_mob_item(player, item)) {
+                if (!give_mob_item(game, player, item)) {
                     // abort if player inventory is full
-                    RL_PUSH(level->items[(int)player->coords.y][(int)player->coords.x], item);
+                    drop_item(game, level, player->coords, item);
                     break;
                 }
             }
@@ -95,48 +95,48 @@ int gameloop(Dungeon *dungeon, int input)
 
         case 'i':
             // open inventory menu
-            inMenu = MENU_INVENTORY;
+            game->inMenu = MENU_INVENTORY;
             break;
 
         case 'w':
             // open wield menu
-            inMenu = MENU_WIELD;
+            game->inMenu = MENU_WIELD;
             break;
 
         case 'W':
             // open wear menu
-            inMenu = MENU_WEAR;
+            game->inMenu = MENU_WEAR;
             break;
 
         case 'f':
-            if (player->equipment.readied) {
+            if (player->inventory->equipment.readied) {
                 // already readied projectile
-                message("Choose a direction");
-                inMenu = MENU_DIRECTION;
+                message(game, "Choose a direction");
+                game->inMenu = MENU_DIRECTION;
             }
             break;
         case 't':
             // open throw menu
-            inMenu = MENU_THROW;
+            game->inMenu = MENU_THROW;
             break;
 
         case 'q':
             // open quaff menu
-            inMenu = MENU_QUAFF;
+            game->inMenu = MENU_QUAFF;
             break;
 
         case 'r':
             // open read menu
-            inMenu = MENU_READ;
+            game->inMenu = MENU_READ;
             break;
 
         case 'd':
             // open throw menu
-            inMenu = MENU_DROP;
+            game->inMenu = MENU_DROP;
             break;
 
         case 'R':
-            resting = 1;
+            game->resting = 1;
             break;
 
         case '>': // check for downstair
@@ -144,7 +144,7 @@ int gameloop(Dungeon *dungeon, int input)
             {
                 if (dungeon->level->depth == MAX_LEVEL)
                     return GAME_WON;
-                if (!increase_depth(dungeon))
+                if (!increase_depth(game, dungeon))
                     return GAME_OOM;
 
                 return GAME_PLAYING;
@@ -157,7 +157,7 @@ int gameloop(Dungeon *dungeon, int input)
             {
                 if (dungeon->level->depth == 1)
                     return GAME_QUIT;
-                if (!decrease_depth(dungeon))
+                if (!decrease_depth(game, dungeon))
                     return GAME_OOM;
 
                 return GAME_PLAYING;
@@ -167,7 +167,7 @@ int gameloop(Dungeon *dungeon, int input)
     }
 
     // skip turn if we're still in the inventory menu
-    if (inMenu)
+    if (game->inMenu)
         return GAME_PLAYING;
 
     // check for player death (i.e. damaged self)
@@ -175,41 +175,39 @@ int gameloop(Dungeon *dungeon, int input)
         return GAME_DEATH;
 
     // cleanup dead mobs
-    cleanup(dungeon);
+    cleanup(game, dungeon);
 
     // heal player & increase turn count
     tick(dungeon);
 
     // update seen tiles (need to update before AI)
-    rl_fov_calculate(level->fov, level->map, player->coords.x, player->coords.y, FOV_RADIUS);
+    update_fov(level);
 
     // display message for item(s) on current tile
-    RL_Heap *is = level->items[(int)player->coords.y][(int)player->coords.x];
+    FloorStack *is = floor_stack(&level->floor, player->coords.x, player->coords.y);
     if (is) {
-        int length = rl_heap_length(is);
-        Item *item = rl_heap_peek(is);
-        if (item && length > 0) {
-            char *buffer = malloc(sizeof(char) * MAX_WIDTH + 1);
-            if (item->amount == 1)
-                snprintf(buffer, MAX_WIDTH + 1, "You see %s", item->name);
-            else // pluralize
-                if (item->pluralName)
-                    snprintf(buffer, MAX_WIDTH + 1, "You see %d %s",
-                            item->amount,
-                            item->pluralName);
-                else
-                    snprintf(buffer, MAX_WIDTH + 1, "You see %d %ss",
-                            item->amount,
-                            item->name);
-            if (length > 1)
-                snprintf(buffer + strlen(buffer), MAX_WIDTH + 1 - strlen(buffer), " (and %d more items)", length - 1);
-            message(buffer);
-        }
+        int length = is->count;
+        Item *item = &is->items[length - 1];
+        char buffer[MAX_WIDTH + 1];
+        if (item->amount == 1)
+            snprintf(buffer, MAX_WIDTH + 1, "You see %s", item->name);
+        else // pluralize
+            if (item->pluralName)
+                snprintf(buffer, MAX_WIDTH + 1, "You see %d %s",
+                        item->amount,
+                        item->pluralName);
+            else
+                snprintf(buffer, MAX_WIDTH + 1, "You see %d %ss",
+                        item->amount,
+                        item->name);
+        if (length > 1)
+            snprintf(buffer + strlen(buffer), MAX_WIDTH + 1 - strlen(buffer), " (and %d more items)", length - 1);
+        message(game, "%s", buffer);
     }
 
     // be a bit kind & handle mob AI only when *not* changing depth
     if (level->depth == dungeon->level->depth)
-        tick_mobs(level);
+        tick_mobs(game, level);
     else
         // changed depth - get the new level
         level = dungeon->level;
@@ -218,34 +216,50 @@ int gameloop(Dungeon *dungeon, int input)
     if (player->hp <= 0)
         return GAME_DEATH;
 
+    // current level changes every turn
+    level->dirty = 1;
+
+    // snapshot state between turns, it is written in the background
+    if (game->autosaveFile && dungeon->turn % AUTOSAVE_TURNS == 0)
+        autosave(game, dungeon, game->autosaveFile);
+
     return GAME_PLAYING;
 }
 
-/*************/
-/**         **/
-/** private **/
-/**         **/
-/*************/
+void tick_mob(Game *game, Mob *mob, Level *level);
+void tick_mobs(Game *game, Level *level)
+{
+    for (int i = 0; i < level->mobCount; ++i)
+        tick_mob(game, &level->mobs[i], level);
+
+    // 1/MOB_SPAWN_CHANCE chance of new mob every turn
+    if (generate(&level->rng, 1, MOB_SPAWN_CHANCE) == 1)
+    {
+        // get random coordinates for new mob, must not be near player
+        RL_Point coords;
+        if (random_free_coords(level, &level->passable, FREE_NO_STAIRS | FREE_HIDDEN, &level->rng, &coords))
+            insert_mob(game, create_mob(game, level->depth, coords, &level->rng), level->mobs, &level->mobCount);
+    }
+}
 
-// alert mobs to player movement or sound (attacks)
 void alert_mobs(Level *level, RL_Point coords)
 {
-    for (int i=0; i<MAX_MOBS; ++i) {
-        Mob *m = level->mobs[i];
-        if (m) {
-            double d = rl_distance_manhattan(coords, m->coords);
-            if (d < MOB_ALERT_RADIUS) {
-                if (m->dijkstra_graph == NULL) {
-                    m->dijkstra_graph = rl_graph_create(level->map, rl_map_is_passable, false);
-                }
-                assert(m->dijkstra_graph);
-                rl_dijkstra_score(m->dijkstra_graph, coords, rl_distance_manhattan);
-            }
+    for (int i=0; i<level->mobCount; ++i) {
+        Mob *m = &level->mobs[i];
+        double d = rl_distance_manhattan(coords, m->coords);
+        if (d < MOB_ALERT_RADIUS) {
+            score_mob_path(m, level->map, coords);
         }
     }
 }
 
-void move_player(Mob *player, RL_Point coords, Level *level)
+/*************/
+/**         **/
+/** private **/
+/**         **/
+/*************/
+
+void move_player(Game *game, Mob *player, RL_Point coords, Level *level)
 {
     // first, check for mob
     Mob *target = get_mob(level, coords);
@@ -253,15 +267,15 @@ void move_player(Mob *player, RL_Point coords, Level *level)
     if (target != NULL)
     {
         // there was an enemy there!
-        int dmg = attack(player, target, player->equipment.weapon);
+        int dmg = attack(game, player, target, player->inventory->equipment.weapon);
         alert_mobs(level, player->coords);
 
         if (dmg > 0)
-            message("You hit the %s for %d damage!",
+            message(game, "You hit the %s for %d damage!",
                     mob_name(target->symbol),
                     dmg);
         else if (dmg == 0)
-            message("You missed the %s!",
+            message(game, "You missed the %s!",
                     mob_name(target->symbol));
     }
     else
@@ -269,51 +283,25 @@ void move_player(Mob *player, RL_Point coords, Level *level)
         // if there was a door, open it first
         RL_Byte *t = rl_map_tile(level->map, player->coords.x, player->coords.y);
         if (t && *t == RL_TileDoor) {
+            own_map(level);
+            t = rl_map_tile(level->map, player->coords.x, player->coords.y);
+            hash_tile(game, level, player->coords.x, player->coords.y);
             *t = RL_TileDoorOpen;
+            hash_tile(game, level, player->coords.x, player->coords.y);
         }
         // then move the player
-        move_mob(player, coords, level);
+        move_mob(game, player, coords, level);
     }
 }
 
-void run_player(Mob *player, Direction dir, Level *level)
+void run_player(Game *game, Mob *player, Direction dir, Level *level)
 {
-    runDir = dir;
-    move_player(player, RL_XY(player->coords.x + dir.xdir, player->coords.y + dir.ydir), level);
-}
-
-// mob AI & spawning
-void tick_mob(Mob *mob, Level *level);
-void tick_mobs(Level *level)
-{
-    for (int i = 0; i < MAX_MOBS; ++i)
-        if (level->mobs[i] != NULL)
-            tick_mob(level->mobs[i], level);
-
-    // 1/20 chance of new mob every turn
-    if (generate(1, 10) == 1)
-    {
-        // get random coordinates for new mob, must not be near player
-        RL_Point coords = random_passable_coords(level);
-        while (rl_fov_is_visible(level->fov, coords.x, coords.y) ||
-                (level->upstair_loc.x == coords.x && level->upstair_loc.y == coords.y) ||
-                (level->downstair_loc.x == coords.x && level->downstair_loc.y == coords.y))
-        {
-            coords = random_passable_coords(level);
-        }
-
-        Mob *mob = create_mob(level->depth, coords);
-
-        if (mob == NULL)
-            return;
-
-        if (!insert_mob(mob, level->mobs))
-            free(mob);
-    }
+    game->runDir = dir;
+    move_player(game, player, RL_XY(player->coords.x + dir.xdir, player->coords.y + dir.ydir), level);
 }
 
 // returns -1 on move, 0 or more damage on attack
-int move_or_attack(Mob *attacker, RL_Point coords, Level *level)
+int move_or_attack(Game *game, Mob *attacker, RL_Point coords, Level *level)
 {
     // first, check for mob
     Mob *target = get_mob(level, coords);
@@ -322,88 +310,85 @@ int move_or_attack(Mob *attacker, RL_Point coords, Level *level)
     {
         alert_mobs(level, coords);
 
-        return attack(attacker, target, attacker->equipment.weapon);
+        return attack(game, attacker, target, mob_equipment(game, attacker).weapon);
     }
     else
-        move_mob(attacker, coords, level);
+        move_mob(game, attacker, coords, level);
 
     return -1;
 }
 
-void tick_mob(Mob *mob, Level *level)
+void tick_mob(Game *game, Mob *mob, Level *level)
 {
     Mob *player = level->player;
 
     if (rl_fov_is_visible(level->fov, mob->coords.x, mob->coords.y))
     {
-        if (mob->dijkstra_graph == NULL) {
-            mob->dijkstra_graph = rl_graph_create(level->map, rl_map_is_passable, false);
-        }
-        assert(mob->dijkstra_graph);
-        rl_dijkstra_score(mob->dijkstra_graph, player->coords, rl_distance_manhattan);
+        score_mob_path(mob, level->map, player->coords);
     }
 
-    if (mob->dijkstra_graph == NULL)
+    if (mob->path == NULL)
     {
         // walk to random tile
-        RL_Point coords = random_coords(level);
+        RL_Point coords = random_coords(level, mob->coords, MOB_WANDER_RADIUS, &mob->rng);
         if (rl_map_is_passable(level->map, coords.x, coords.y))
         {
-            mob->dijkstra_graph = rl_graph_create(level->map, rl_map_is_passable, false);
-            assert(mob->dijkstra_graph);
-            rl_dijkstra_score(mob->dijkstra_graph, coords, rl_distance_manhattan);
+            score_mob_path(mob, level->map, coords);
         }
     }
 
-    if (mob->dijkstra_graph)
+    if (mob->path)
     {
         // find mobs coords in graph and sellect smallest neighbor
+        const RL_GraphNode *n = mob_path_node(mob->path, mob->coords);
         RL_GraphNode *next_node = NULL;
-        const RL_Point *target_coords = NULL;
-        for (size_t i=0; i<mob->dijkstra_graph->length; ++i) {
-            const RL_GraphNode *n = &mob->dijkstra_graph->nodes[i];
-            if (n->point.x == mob->coords.x && n->point.y == mob->coords.y) {
-                for (size_t j=0; j<n->neighbors_length; ++j) {
-                    if (next_node == NULL || n->neighbors[j]->score < next_node->score) {
-                        next_node = n->neighbors[j];
-                    }
-                }
-            }
-            if (n->score == 0) {
-                target_coords = &n->point;
+        for (size_t j=0; n && j<n->neighbors_length; ++j) {
+            if (next_node == NULL || n->neighbors[j]->score < next_node->score) {
+                next_node = n->neighbors[j];
             }
         }
+        const RL_GraphNode *target_node = mob_path_node(mob->path, mob->path->target);
         if (next_node) {
-            Mob *target = get_mob(level, next_node->point);
+            // attacking rescores paths, which gives a mob sharing its path
+            // with a clone a new graph - keep track of the node by coords
+            RL_Point origin = mob->path->origin;
+            RL_Point next_coords = RL_XY(next_node->point.x + origin.x, next_node->point.y + origin.y);
+
+            Mob *target = get_mob(level, next_coords);
             if (target == NULL || target == level->player) {
-                int dmg = move_or_attack(mob, next_node->point, level);
-                if (dmg > 0)
-                    message("You got hit by the %s for %d damage!",
+                int dmg = move_or_attack(game, mob, next_coords, level);
+                if (dmg > 0) {
+                    message(game, "You got hit by the %s for %d damage!",
                             mob_name(mob->symbol),
                             dmg);
-                else if (dmg == 0)
-                    message("The %s missed!", mob_name(mob->symbol));
-            } else if (target_coords) {
+                    if (player->hp <= 0 && !game->killer)
+                        game->killer = mob->symbol;
+                } else if (dmg == 0)
+                    message(game, "The %s missed!", mob_name(mob->symbol));
+            } else if (target_node) {
                 // running into mob - destroy graph
-                rl_graph_destroy(mob->dijkstra_graph);
-                mob->dijkstra_graph = NULL;
+                release_mob_path(mob);
             }
-            if (mob->dijkstra_graph && (next_node->score == 0 || next_node->score == FLT_MAX)) {
-                rl_graph_destroy(mob->dijkstra_graph);
-                mob->dijkstra_graph = NULL;
+            if (mob->path) {
+                next_node = mob_path_node(mob->path, next_coords);
+                if (next_node == NULL || next_node->score == 0 || next_node->score == FLT_MAX) {
+                    release_mob_path(mob);
+                }
             }
         }
     }
 }
 
-void reward_exp(Mob *player, Mob *mob)
+// returns exp rewarded
+int reward_exp(Mob *player, Mob *mob)
 {
     // calculate exp based on difficulty of mob
-    player->attrs.exp += 100*mob->difficulty;
+    int exp = 100*mob->difficulty;
+    player->attrs.exp += exp;
 
     // max level
     if (player->attrs.level == MAX_PLAYER_LEVEL)
-        return;
+        return exp;
 
     // level up condition
     if (player->attrs.exp >= player->attrs.expNext)
@@ -414,6 +399,8 @@ void reward_exp(Mob *player, Mob *mob)
         player->maxHP += 5;
         player->hp = player->maxHP;
     }
+
+    return exp;
 }
 
 void tick(Dungeon *dungeon)
@@ -421,9 +408,9 @@ void tick(Dungeon *dungeon)
     Level *level = dungeon->level;
     Mob *player = level->player;
 
-    if (dungeon->turn % 10 == 0)
+    if (dungeon->turn % HEAL_TURNS == 0)
     {
-        // heal player every 10 turns
+        // heal player every HEAL_TURNS turns
         if (player->hp < player->maxHP)
             player->hp += 1;
     }
@@ -432,40 +419,35 @@ void tick(Dungeon *dungeon)
 }
 
 // cleanup dead mobs
-void cleanup(Dungeon *dungeon)
+void cleanup(Game *game, Dungeon *dungeon)
 {
     Level *level = dungeon->level;
     Mob *player = level->player;
 
-    for (int i = 0; i < MAX_MOBS; ++i)
+    for (int i = 0; i < level->mobCount; ++i)
     {
-        if (level->mobs[i] != NULL)
+        // kill mob if HP 0
+        Mob *mob = &level->mobs[i];
+        if (mob->hp <= 0)
         {
-            // kill mob if HP 0
-            Mob *mob = level->mobs[i];
-            if (mob->hp <= 0)
-            {
-                // transfer items & equipment to floor
-                Item *item;
-                for (int i=0; i<mob->itemCount; i++) {
-                    item = mob->items[i];
-                    RL_PUSH(level->items[(int)mob->coords.y][(int)mob->coords.x], item);
-                }
-
-                if (mob->dijkstra_graph) {
-                    rl_graph_destroy(mob->dijkstra_graph);
-                    mob->dijkstra_graph = NULL;
-                }
-
-                // add to killed mobs queue
-                RL_PUSH(dungeon->killed, mob);
+            // transfer items & equipment to floor
+            materialize_loot(game, mob);
+            Inventory *inventory = mob->inventory;
+            for (int j=0; inventory && j<inventory->itemCount; j++) {
+                Item *item = inventory->items[j];
+                hash_inventory_item(game, item);
+                drop_item(game, level, mob->coords, item);
+            }
 
-                // clear mob in level & reward exp
-                reward_exp(player, mob);
-                level->mobs[i] = NULL;
+            // reward exp & count kill
+            record_kill(&dungeon->kills, mob, reward_exp(player, mob));
+            message(game, "The %s has died.", mob_name(mob->symbol));
 
-                message("The %s has died.", mob_name(mob->symbol));
-            }
+            // free mob & clear it in level
+            hash_mob(game, mob);
+            destroy_mob(mob);
+            remove_mob(i, level->mobs, &level->mobCount);
+            --i; // last mob was moved into this slot
         }
     }
 }
@@ -473,23 +455,35 @@ void cleanup(Dungeon *dungeon)
 // change current depth to next level deep
 // if there is no next level, create one
 // return 0 on error
-int increase_depth(Dungeon *dungeon)
+int increase_depth(Game *game, Dungeon *dungeon)
 {
     if (dungeon->level->depth == MAX_LEVEL)
         return 0;
 
-    if (dungeon->level->next == NULL)
+    dungeon->level->leftTurn = dungeon->turn;
+
+    if (dungeon->level->next != NULL)
+    {
+        // load next level from snapshot if we haven't been there yet, or
+        // unpack it
+        if (!load_level(game, dungeon, dungeon->level->next))
+            return 0;
+    }
+    else
     {
-        // initialize next level
-        Level *level;
-        level = create_level(dungeon->level->depth + 1);
+        // initialize next level, unless it was generated in the background
+        Level *level = take_pregenerated_level(game, dungeon);
+        if (level == NULL)
+            level = create_level(game, dungeon->level->depth + 1, dungeon->width, dungeon->height);
+        if (level == NULL)
+            return 0;
 
         // set our link relationship to next level
         dungeon->level->next = level;
         level->prev = dungeon->level;
 
         // randomly fill dungeon
-        if (!init_level(level, dungeon->player))
+        if (!init_level(game, level, dungeon->player))
             return 0;
     }
 
@@ -500,67 +494,143 @@ int increase_depth(Dungeon *dungeon)
     dungeon->player->coords = dungeon->level->upstair_loc;
 
     // update FOV
-    rl_fov_calculate(dungeon->level->fov, dungeon->level->map, dungeon->player->coords.x, dungeon->player->coords.y, FOV_RADIUS);
+    update_fov(dungeon->level);
+
+    catch_up_level(game, dungeon->level, dungeon->turn);
+    pack_far_levels(dungeon);
 
     return 1;
 }
 
 // change current depth to previous level
 // return 0 on error
-int decrease_depth(Dungeon *dungeon)
+int decrease_depth(Game *game, Dungeon *dungeon)
 {
     if (dungeon->level->prev == NULL)
         return 0;
 
+    // load previous level from snapshot if we haven't been there yet, or
+    // unpack it
+    if (!load_level(game, dungeon, dungeon->level->prev))
+        return 0;
+    dungeon->level->leftTurn = dungeon->turn;
+
     // set level to previous level
     dungeon->level = dungeon->level->prev;
 
     // place player on downstair
     dungeon->player->coords = dungeon->level->downstair_loc;
 
+    // update FOV, so the level catches up out of sight of the player
+    update_fov(dungeon->level);
+
+    catch_up_level(game, dungeon->level, dungeon->turn);
+    pack_far_levels(dungeon);
+
     return 1;
 }
 
-int handle_input(Dungeon *dungeon)
+// advance level by the turns since the player left it all at once instead
+// of turn by turn: mobs heal, wander off somewhere nearby out of sight &
+// new mobs spawn about as often as tick_mobs spawns them
+void catch_up_level(Game *game, Level *level, int turn)
+{
+    int turns = level->leftTurn < 0 ? 0 : turn - level->leftTurn;
+    level->leftTurn = -1;
+    if (turns <= 0)
+        return;
+
+    int radius = turns < MOB_WANDER_RADIUS ? turns : MOB_WANDER_RADIUS;
+    for (int i = 0; i < level->mobCount; ++i)
+    {
+        Mob *mob = &level->mobs[i];
+        int hp = mob->hp + turns / HEAL_TURNS;
+        hash_mob(game, mob);
+        mob->hp = hp < mob->maxHP ? hp : mob->maxHP;
+        hash_mob(game, mob);
+
+        // wherever it was walking is stale by now
+        release_mob_path(mob);
+        for (int tries = 0; tries < CATCH_UP_TRIES; ++tries)
+        {
+            RL_Point coords = random_coords(level, mob->coords, radius, &mob->rng);
+            if (!rl_fov_is_visible(level->fov, coords.x, coords.y) && move_mob(game, mob, coords, level))
+                break;
+        }
+    }
+
+    // turns between spawns are geometric, so draw those instead of a chance
+    // per turn
+    int spawnTurn = 0;
+    while (level->mobCount < MAX_MOBS)
+    {
+        double u = (next_random(&level->rng) + 1.0) / 4294967296.0;
+        spawnTurn += 1 + (int) (log(u) / log(1.0 - 1.0 / MOB_SPAWN_CHANCE));
+        if (spawnTurn > turns)
+            break;
+
+        RL_Point coords;
+        if (random_free_coords(level, &level->passable, FREE_NO_STAIRS | FREE_HIDDEN, &level->rng, &coords))
+            insert_mob(game, create_mob(game, level->depth, coords, &level->rng), level->mobs, &level->mobCount);
+    }
+}
+
+// pack levels too far from the player to be entered soon, they're unpacked
+// by load_level when they are (if packing runs out of memory they just
+// stay as they are)
+void pack_far_levels(Dungeon *dungeon)
+{
+    if (dungeon->residentDistance < 0)
+        return;
+
+    Level *level = dungeon->level;
+    while (level->prev)
+        level = level->prev;
+    for (; level; level = level->next)
+        if (abs(level->depth - dungeon->level->depth) > dungeon->residentDistance)
+            pack_level(dungeon, level);
+}
+
+int handle_input(Game *game, Dungeon *dungeon)
 {
     Mob *player = dungeon->player;
     Level *level = dungeon->level;
 
-    if (resting)
+    if (game->resting)
     {
         if (player->hp >= player->maxHP)
-            resting = 0;
+            game->resting = 0;
 
         // if player can see any mobs, reset resting flag
-        for (int i = 0; i < MAX_MOBS; ++i)
-            if (level->mobs[i] != NULL && rl_fov_is_visible(level->fov, level->mobs[i]->coords.x, level->mobs[i]->coords.y))
-                resting = 0;
+        for (int i = 0; i < level->mobCount; ++i)
+            if (rl_fov_is_visible(level->fov, level->mobs[i].coords.x, level->mobs[i].coords.y))
+                game->resting = 0;
 
         // if we're still resting, don't handle input
-        if (resting)
+        if (game->resting)
             return 0;
     }
 
-    if (is_running())
+    if (is_running(game))
     {
-        Direction dir = runDir;
+        Direction dir = game->runDir;
         RL_Point target = RL_XY(player->coords.x + dir.xdir, player->coords.y + dir.ydir);
 
         // if player can see any mobs, reset running flag
-        for (int i = 0; i < MAX_MOBS; ++i)
-            if (level->mobs[i] != NULL && rl_fov_is_visible(level->fov, level->mobs[i]->coords.x, level->mobs[i]->coords.y))
-                runDir = DIRECTION(0, 0);
+        for (int i = 0; i < level->mobCount; ++i)
+            if (rl_fov_is_visible(level->fov, level->mobs[i].coords.x, level->mobs[i].coords.y))
+                game->runDir = DIRECTION(0, 0);
 
         if (!rl_map_is_passable(level->map, target.x, target.y) ||
                 get_enemy(level, target) != NULL)
         {
-            runDir = DIRECTION(0, 0);
+            game->runDir = DIRECTION(0, 0);
         }
 
         // if we're still running, move the player and don't handle input
-        if (is_running())
+        if (is_running(game))
         {
-            move_player(player, target, level);
+            move_player(game, player, target, level);
 
             return 0;
         }
@@ -570,58 +640,58 @@ int handle_input(Dungeon *dungeon)
 }
 
 Mob *mob_in_dir(Level *level, Direction dir);
-void apply_item_effects(Level *level, Mob *mob, Item *item);
-void menu_management(int input, Level *level)
+void apply_item_effects(Game *game, Level *level, Mob *mob, Item *item);
+void menu_management(Game *game, int input, Level *level)
 {
     Mob *player = level->player;
 
-    if (inMenu == MENU_WIELD)
+    if (game->inMenu == MENU_WIELD)
     {
         // wield chosen weapon
-        for (int i = 0; i < player->itemCount; ++i)
+        for (int i = 0; i < player->inventory->itemCount; ++i)
         {
-            Item *item = player->items[i];
+            Item *item = player->inventory->items[i];
             if (item_menu_symbol(i - 1) == input)
             {
                 if (item->type == ITEM_WEAPON)
-                    player->equipment.weapon = item;
+                    player->inventory->equipment.weapon = item;
                 else
-                    message("That is not a weapon!");
+                    message(game, "That is not a weapon!");
 
                 break;
             }
         }
     }
 
-    if (inMenu == MENU_WEAR)
+    if (game->inMenu == MENU_WEAR)
     {
         // wear chosen armor
-        for (int i = 0; i < player->itemCount; ++i)
+        for (int i = 0; i < player->inventory->itemCount; ++i)
         {
-            Item *item = player->items[i];
+            Item *item = player->inventory->items[i];
             if (item_menu_symbol(i - 1) == input)
             {
                 if (item->type == ITEM_ARMOR)
-                    player->equipment.armor = item;
+                    player->inventory->equipment.armor = item;
                 else
-                    message("That is not wearable!");
+                    message(game, "That is not wearable!");
 
                 break;
             }
         }
     }
 
-    if (inMenu == MENU_DROP)
+    if (game->inMenu == MENU_DROP)
     {
         // drop chosen item
-        for (int i = 0; i < player->itemCount; ++i)
+        for (int i = 0; i < player->inventory->itemCount; ++i)
         {
-            Item *item = player->items[i];
+            Item *item = player->inventory->items[i];
             if (item_menu_symbol(i - 1) == input)
             {
                 // transfer to ground tile
-                if (remove_mob_item(player, item)) {
-                    RL_PUSH(level->items[(int)player->coords.y][(int)player->coords.x], item);
+                if (remove_mob_item(game, player, item)) {
+                    drop_item(game, level, player->coords, item);
                 }
 
                 break;
@@ -629,23 +699,25 @@ void menu_management(int input, Level *level)
         }
     }
 
-    if (inMenu == MENU_QUAFF)
+    if (game->inMenu == MENU_QUAFF)
     {
         // quaff potion
-        for (int i = 0; i < player->itemCount; ++i)
+        for (int i = 0; i < player->inventory->itemCount; ++i)
         {
-            Item *item = player->items[i];
+            Item *item = player->inventory->items[i];
             if (item_menu_symbol(i - 1) == input)
             {
                 if (item->type == ITEM_POTION)
                 {
-                    apply_item_effects(level, player, item);
+                    apply_item_effects(game, level, player, item);
 
-                    decrement_mob_item(player, item);
+                    // the last one is gone
+                    if (decrement_mob_item(game, player, item) == 1)
+                        free(item);
                 }
                 else
                 {
-                    message("That is not drinkable!");
+                    message(game, "That is not drinkable!");
                 }
 
                 break;
@@ -653,22 +725,23 @@ void menu_management(int input, Level *level)
         }
     }
 
-    if (inMenu == MENU_READ)
+    if (game->inMenu == MENU_READ)
     {
         // read scroll
-        for (int i = 0; i < player->itemCount; ++i)
+        for (int i = 0; i < player->inventory->itemCount; ++i)
         {
-            Item *item = player->items[i];
+            Item *item = player->inventory->items[i];
             if (item_menu_symbol(i - 1) == input)
             {
                 if (item->type == ITEM_SCROLL)
                 {
-                    apply_item_effects(level, player, item);
-                    decrement_mob_item(player, item);
+                    apply_item_effects(game, level, player, item);
+                    if (decrement_mob_item(game, player, item) == 1)
+                        free(item);
                 }
                 else
                 {
-                    message("That is not readable!");
+                    message(game, "That is not readable!");
                 }
 
                 break;
@@ -676,26 +749,26 @@ void menu_management(int input, Level *level)
         }
     }
 
-    if (inMenu == MENU_THROW)
+    if (game->inMenu == MENU_THROW)
     {
         // throw chosen projectile
-        for (int i = 0; i < player->itemCount; ++i)
+        for (int i = 0; i < player->inventory->itemCount; ++i)
         {
-            Item *item = player->items[i];
+            Item *item = player->inventory->items[i];
             if (item_menu_symbol(i - 1) == input)
             {
                 if (item->type == ITEM_WEAPON || item->type == ITEM_PROJECTILE || item->type == ITEM_POTION)
                 {
-                    player->equipment.readied = item; // ready item for throwing
-                    message("Choose a direction");
-                    inMenu = MENU_DIRECTION;
+                    player->inventory->equipment.readied = item; // ready item for throwing
+                    message(game, "Choose a direction");
+                    game->inMenu = MENU_DIRECTION;
 
                     return;
                 }
                 else
                 {
                     // TODO let them throw it anyway?
-                    message("That is not throwable!");
+                    message(game, "That is not throwable!");
                 }
 
                 break;
@@ -703,9 +776,9 @@ void menu_management(int input, Level *level)
         }
     }
 
-    if (inMenu == MENU_DIRECTION)
+    if (game->inMenu == MENU_DIRECTION)
     {
-        Item *item = player->equipment.readied;
+        Item *item = player->inventory->equipment.readied;
         Direction dir = {0};
 
         // throw chosen projectile in directions
@@ -714,47 +787,47 @@ void menu_management(int input, Level *level)
         {
             case KEY_LEFT:
             case 'h':
-                decrement_mob_item(player, item);
+                decrement_mob_item(game, player, item);
                 dir = DIRECTION(-1, 0);
                 break;
             case KEY_RIGHT:
             case 'l':
-                decrement_mob_item(player, item);
+                decrement_mob_item(game, player, item);
                 dir = DIRECTION(1,  0);
                 break;
             case KEY_DOWN:
             case 'j':
-                decrement_mob_item(player, item);
+                decrement_mob_item(game, player, item);
                 dir = DIRECTION(0,  1);
                 break;
             case KEY_UP:
             case 'k':
-                decrement_mob_item(player, item);
+                decrement_mob_item(game, player, item);
                 dir = DIRECTION(0, -1);
                 break;
 
             default:
-                message("That is an invalid direction");
+                message(game, "That is an invalid direction");
                 break;
         }
 
         Mob *target = mob_in_dir(level, dir);
         if (target) {
             if (item->type == ITEM_POTION) {
-                apply_item_effects(level, target, item);
+                apply_item_effects(game, level, target, item);
             } else {
-                int dmg = attack(level->player, target, item);
+                int dmg = attack(game, level->player, target, item);
                 alert_mobs(level, level->player->coords);
 
                 if (dmg > 0)
-                    message("You hit the %s for %d damage!",
+                    message(game, "You hit the %s for %d damage!",
                             mob_name(target->symbol),
                             dmg);
                 else if (dmg == 0)
-                    message("You missed the %s!",
+                    message(game, "You missed the %s!",
                             mob_name(target->symbol));
                 if (dmg < 0)
-                    message("You healed the %s for %d damage!",
+                    message(game, "You healed the %s for %d damage!",
                             mob_name(target->symbol),
                             -1 * dmg);
             }
@@ -762,7 +835,7 @@ void menu_management(int input, Level *level)
     }
 
     // turn off inventory management
-    inMenu = 0;
+    game->inMenu = 0;
 }
 
 // get mob in dir from player
@@ -791,22 +864,26 @@ Mob *mob_in_dir(Level *level, Direction dir)
 }
 
 // apply effects of item invoked by mob
-void apply_item_effects(Level *level, Mob *mob, Item *item)
+void apply_item_effects(Game *game, Level *level, Mob *mob, Item *item)
 {
     Mob *player = level->player;
     int dmg;
     if (item->type == ITEM_POTION) {
         switch (item->potion) {
             case POTION_ACID:
-                dmg = generate(1, 8);
+                dmg = generate(&game->random.streams[RNG_COMBAT], 1, 8);
+                hash_mob(game, mob);
                 mob->hp -= dmg;
+                hash_mob(game, mob);
 
                 break;
             case POTION_HEAL:
-                dmg = -1 * generate(1, 8);
+                dmg = -1 * generate(&game->random.streams[RNG_COMBAT], 1, 8);
+                hash_mob(game, mob);
                 mob->hp -= dmg;
                 if (mob->hp > mob->maxHP)
                     mob->hp = mob->maxHP;
+                hash_mob(game, mob);
 
                 break;
 
@@ -816,15 +893,15 @@ void apply_item_effects(Level *level, Mob *mob, Item *item)
 
         if (mob->coords.x == player->coords.x && mob->coords.y == player->coords.y) {
             if (dmg > 0) {
-                message("Ouch, that burns! You were hurt for %d damage.", dmg);
+                message(game, "Ouch, that burns! You were hurt for %d damage.", dmg);
             } else if (dmg < 0) {
-                message("That feels better! You were healed for %d damage.", -1 * dmg);
+                message(game, "That feels better! You were healed for %d damage.", -1 * dmg);
             }
         } else {
             if (dmg > 0) {
-                message("You burned the %s for %d damage.", mob_name(mob->symbol), dmg);
+                message(game, "You burned the %s for %d damage.", mob_name(mob->symbol), dmg);
             } else if (dmg < 0) {
-                message("You healed the %s for %d damage.", mob_name(mob->symbol), -1 * dmg);
+                message(game, "You healed the %s for %d damage.", mob_name(mob->symbol), -1 * dmg);
             }
         }
     }
@@ -832,21 +909,24 @@ void apply_item_effects(Level *level, Mob *mob, Item *item)
     if (item->type == ITEM_SCROLL) {
         switch (item->scroll) {
             case SCROLL_FIRE:
-                for (int i = 0; i < MAX_MOBS; ++i) {
-                    Mob *m = level->mobs[i];
-                    if (m && rl_fov_is_visible(level->fov, m->coords.x, m->coords.y)) {
+                for (int i = 0; i < level->mobCount; ++i) {
+                    Mob *m = &level->mobs[i];
+                    if (rl_fov_is_visible(level->fov, m->coords.x, m->coords.y)) {
                         // damage mob
-                        int dmg = generate(1, 8);
-                        message("You scorched the %s for %d damage.", mob_name(m->symbol), dmg);
+                        int dmg = generate(&game->random.streams[RNG_COMBAT], 1, 8);
+                        message(game, "You scorched the %s for %d damage.", mob_name(m->symbol), dmg);
+                        hash_mob(game, m);
                         m->hp -= dmg;
+                        hash_mob(game, m);
                     }
                 }
 
                 break;
             case SCROLL_TELEPORT:
-                message("You feel disoriented.");
-                RL_Point coords = random_passable_coords(level);
-                player->coords = coords;
+                message(game, "You feel disoriented.");
+                RL_Point coords;
+                if (random_free_coords(level, &level->passable, FREE_ANY, &level->rng, &coords))
+                    player->coords = coords;
 
             default:
                 break;
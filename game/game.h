@@ -7,6 +7,7 @@
 #define GAME_DEATH 3
 #define GAME_OOM 4
 #define GAME_ERROR 5
+#define GAME_SAVE 6
 
 #define MENU_INVENTORY 1
 #define MENU_WIELD     2
@@ -19,17 +20,31 @@
 
 #define FOV_RADIUS 8
 
+#define HEAL_TURNS       10 // turns per hit point healed
+#define MOB_SPAWN_CHANCE 10 // one in this many turns a mob spawns
+#define CATCH_UP_TRIES   4  // tiles a mob tries to wander to while the player is away
+
 #include "dungeon.h"
 #include "lib/roguelike.h"
 
+// play one turn of game in dungeon
 // return GAME constant
-int gameloop(Dungeon *dungeon, int input);
+int gameloop(Game *game, Dungeon *dungeon, int input);
+
+// mob AI & spawning of one turn (part of gameloop)
+void tick_mobs(Game *game, Level *level);
+
+// alert mobs near coords to player movement or sound (attacks)
+void alert_mobs(Level *level, RL_Point coords);
 
 // does thing like autorest, and TODO automove
 // return 1 if we should grab input this turn
-int handle_input(Dungeon *dungeon);
+int handle_input(Game *game, Dungeon *dungeon);
 
 // return one of MENU_* consts if in menu
-int get_menu();
+int get_menu(const Game *game);
+
+// autosave to filename every AUTOSAVE_TURNS turns (NULL to disable)
+void set_autosave(Game *game, const char *filename);
 
 #endif
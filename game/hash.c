@@ -0,0 +1,173 @@
+#include "hash.h"
+#include "context.h"
+#include "random.h"
+
+// key kinds, so equal state of different kinds gets different keys
+#define HASH_MOB       1
+#define HASH_INVENTORY 2
+#define HASH_FLOOR     3
+#define HASH_TILE      4
+#define HASH_PLAYER    5
+#define HASH_TURN      6
+#define HASH_RNG       7
+#define HASH_STAIRS    8
+
+// splitmix64 finalizer
+uint64_t hash_mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+
+    return x;
+}
+
+// key of one piece of state, stands in for a lookup in a random key table
+uint64_t hash_key(int kind, uint64_t a, uint64_t b)
+{
+    return hash_mix(hash_mix(((uint64_t) kind << 56) ^ a) ^ b);
+}
+
+uint64_t tile_position(int depth, int x, int y)
+{
+    return ((uint64_t) depth << 48) ^ ((uint64_t) (uint32_t) y << 24) ^ (uint32_t) x;
+}
+
+uint64_t mob_key(const Mob *mob)
+{
+    return hash_key(HASH_MOB,
+            tile_position(mob->depth, mob->coords.x, mob->coords.y),
+            ((uint64_t) (unsigned char) mob->symbol << 32) ^ (uint32_t) mob->hp);
+}
+
+uint64_t inventory_key(const Item *item)
+{
+    return hash_key(HASH_INVENTORY, (uint32_t) item->id, (uint32_t) item->amount);
+}
+
+uint64_t floor_key(const Level *level, RL_Point coords, const Item *item)
+{
+    return hash_key(HASH_FLOOR,
+            tile_position(level->depth, coords.x, coords.y),
+            ((uint64_t) (uint32_t) item->id << 32) ^ (uint32_t) item->amount);
+}
+
+uint64_t tile_key(const Level *level, int x, int y)
+{
+    return hash_key(HASH_TILE, tile_position(level->depth, x, y), *rl_map_tile(level->map, x, y));
+}
+
+uint64_t stairs_key(const Level *level)
+{
+    return hash_key(HASH_STAIRS,
+            tile_position(level->depth, level->upstair_loc.x, level->upstair_loc.y),
+            tile_position(level->depth, level->downstair_loc.x, level->downstair_loc.y));
+}
+
+void hash_mob(Game *game, const Mob *mob)
+{
+    if (mob->type != MOB_PLAYER)
+        game->hash ^= mob_key(mob);
+}
+
+void hash_inventory_item(Game *game, const Item *item)
+{
+    game->hash ^= inventory_key(item);
+}
+
+void hash_floor_item(Game *game, const Level *level, RL_Point coords, const Item *item)
+{
+    game->hash ^= floor_key(level, coords, item);
+}
+
+void hash_tile(Game *game, const Level *level, int x, int y)
+{
+    game->hash ^= tile_key(level, x, y);
+}
+
+void hash_map(Game *game, const Level *level)
+{
+    for (unsigned int y = 0; y < level->map->height; ++y)
+        for (unsigned int x = 0; x < level->map->width; ++x)
+            game->hash ^= tile_key(level, x, y);
+    game->hash ^= stairs_key(level);
+}
+
+uint64_t inventory_hash(const Mob *mob);
+uint64_t level_hash(const Level *level)
+{
+    // packed levels keep what they added, levels still in a save snapshot
+    // aren't hashed until loaded
+    if (level->packed)
+        return level->packedHash;
+    if (level->map == NULL)
+        return 0;
+
+    uint64_t hash = 0;
+    for (unsigned int y = 0; y < level->map->height; ++y)
+        for (unsigned int x = 0; x < level->map->width; ++x)
+            hash ^= tile_key(level, x, y);
+    hash ^= stairs_key(level);
+
+    const FloorItems *floor = &level->floor;
+    for (int i = 0; i < floor->count; ++i)
+    {
+        const FloorStack *stack = &floor->stacks[i];
+        RL_Point coords = RL_XY(stack->tile % floor->width, stack->tile / floor->width);
+        for (int j = 0; j < stack->count; ++j)
+            hash ^= floor_key(level, coords, &stack->items[j]);
+    }
+
+    for (int i = 0; i < level->mobCount; ++i)
+        hash ^= mob_key(&level->mobs[i]) ^ inventory_hash(&level->mobs[i]);
+
+    return hash;
+}
+
+/*************/
+/**         **/
+/** private **/
+/**         **/
+/*************/
+
+// hash of state that changes every turn, cheaper to mix in than to track
+uint64_t turn_hash(const Game *game, const Dungeon *dungeon)
+{
+    const Mob *player = dungeon->player;
+
+    return hash_key(HASH_PLAYER,
+                tile_position(dungeon->level->depth, player->coords.x, player->coords.y),
+                ((uint64_t) (uint32_t) player->hp << 32) ^ (uint32_t) player->maxHP) ^
+        hash_key(HASH_PLAYER, player->attrs.level, (uint32_t) player->attrs.exp) ^
+        hash_key(HASH_TURN, (uint32_t) dungeon->turn, dungeon->level->rng.state) ^
+        hash_key(HASH_RNG, game->random.streams[RNG_COMBAT].state, game->random.streams[RNG_LOOT].state);
+}
+
+uint64_t inventory_hash(const Mob *mob)
+{
+    uint64_t hash = 0;
+    for (int i = 0; mob->inventory && i < mob->inventory->itemCount; ++i)
+        hash ^= inventory_key(mob->inventory->items[i]);
+
+    return hash;
+}
+
+uint64_t state_hash(const Game *game, const Dungeon *dungeon)
+{
+    return game->hash ^ turn_hash(game, dungeon);
+}
+
+uint64_t full_hash(const Game *game, const Dungeon *dungeon)
+{
+    uint64_t hash = inventory_hash(dungeon->player);
+
+    Level *level = dungeon->level;
+    while (level->prev)
+        level = level->prev;
+    for (; level; level = level->next)
+        hash ^= level_hash(level);
+
+    return hash ^ turn_hash(game, dungeon);
+}
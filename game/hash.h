@@ -0,0 +1,37 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include "dungeon.h"
+#include <stdint.h>
+
+// Zobrist-style hash of the game world (map tiles, mobs, floor items and
+// inventories), kept in the game context & updated by toggling the key of
+// each piece of state before & after it changes. Keys are mixed from the
+// state itself, so there are no key tables to size.
+
+// toggle mob depth, position, hp & symbol (the player is hashed in
+// state_hash)
+void hash_mob(Game *game, const Mob *mob);
+
+// toggle item & amount in a mob inventory
+void hash_inventory_item(Game *game, const Item *item);
+
+// toggle item on a level floor tile
+void hash_floor_item(Game *game, const Level *level, RL_Point coords, const Item *item);
+
+// toggle a level map tile
+void hash_tile(Game *game, const Level *level, int x, int y);
+
+// toggle every tile of level map & the stairs
+void hash_map(Game *game, const Level *level);
+
+// what level adds to the world hash, recomputed from scratch
+uint64_t level_hash(const Level *level);
+
+// world hash combined with the player, turn & RNG state
+uint64_t state_hash(const Game *game, const Dungeon *dungeon);
+
+// state_hash recomputed from scratch, to check the incremental hash
+uint64_t full_hash(const Game *game, const Dungeon *dungeon);
+
+#endif
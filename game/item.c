@@ -2,6 +2,8 @@
 
 #include "item.h"
 #include "random.h"
+#include "table.h"
+#include "context.h"
 
 /* static const char **unknownItems; */
 /* static const char **knownItems; */
@@ -68,34 +70,29 @@ int is_stackable(Item item)
     return 0;
 }
 
-int latestItemId = 0;
-
-Item *generate_gold(int depth);
-Item *generate_weapon(int depth);
-Item *generate_armor(int depth);
-Item *generate_potion(int depth);
-Item *generate_scroll(int depth);
-Item *create_item(int depth, int type)
+// next unique item ID of game, prototypes (no game) all get ID 0
+int next_item_id(Game *game)
 {
-    Item *i = NULL;
+    return game ? game->latestItemId++ : 0;
+}
 
+Item *generate_gold(Game *game, int depth);
+Item *create_item(Game *game, int depth, int type)
+{
     if (type == ITEM_GOLD)
-        i = generate_gold(depth);
-    else if (type == ITEM_WEAPON)
-        i = generate_weapon(depth);
-    else if (type == ITEM_ARMOR)
-        i = generate_armor(depth);
-    else if (type == ITEM_POTION)
-        i = generate_potion(depth);
-    else if (type == ITEM_SCROLL)
-        i = generate_scroll(depth);
+        return generate_gold(game, depth);
 
-    return i;
+    // pick item kind from the loot table
+    const LootEntry *loot = sample_loot(depth, type, &game->random.streams[RNG_LOOT]);
+    if (loot == NULL)
+        return NULL;
+
+    return loot->create(game);
 }
 
 // type-specific item generators
 
-Item *generate_gold(int depth)
+Item *generate_gold(Game *game, int depth)
 {
     Item *item = malloc(sizeof(Item));
 
@@ -104,19 +101,18 @@ Item *generate_gold(int depth)
 
     *item = (Item) {0};
 
-    // generate depth*50/2 - depth*50 gold
-    item->amount = generate(depth*50/2, depth*50);
+    // generate depth*50/2 - depth*50 gold, prototypes (no game) get the least
+    item->amount = game ? generate(&game->random.streams[RNG_LOOT], depth*50/2, depth*50) : depth*50/2;
     item->type = ITEM_GOLD;
     item->name = item->unknownName = "gold";
     item->pluralName = "gold";
-    item->id = latestItemId++; // give item random ID
+    item->id = next_item_id(game); // give item random ID
 
     return item;
 }
 
-Item *generate_potion(int depth)
+Item *init_potion(Game *game)
 {
-    (void) depth; // currently unused
     Item *item = malloc(sizeof(Item));
 
     if (item == NULL)
@@ -125,24 +121,33 @@ Item *generate_potion(int depth)
     *item = (Item) {0};
     item->amount = 1;
     item->type = ITEM_POTION;
-    item->id = latestItemId++; // give item random ID
-
-    if (generate(1, 100) < 50) {
-        item->name = item->unknownName = "healing potion";
-        item->pluralName = "healing potions";
-        item->potion = POTION_HEAL;
-    } else {
-        item->name = item->unknownName = "acidic potion";
-        item->pluralName = "acidic potions";
-        item->potion = POTION_ACID;
-    }
+    item->id = next_item_id(game); // give item random ID
+
+    return item;
+}
+
+Item *healing_potion(Game *game)
+{
+    Item *item = init_potion(game);
+    item->name = item->unknownName = "healing potion";
+    item->pluralName = "healing potions";
+    item->potion = POTION_HEAL;
 
     return item;
 }
 
-Item *generate_scroll(int depth)
+Item *acidic_potion(Game *game)
+{
+    Item *item = init_potion(game);
+    item->name = item->unknownName = "acidic potion";
+    item->pluralName = "acidic potions";
+    item->potion = POTION_ACID;
+
+    return item;
+}
+
+Item *init_scroll(Game *game)
 {
-    (void) depth; // currently unused
     Item *item = malloc(sizeof(Item));
 
     if (item == NULL)
@@ -151,27 +156,42 @@ Item *generate_scroll(int depth)
     *item = (Item) {0};
     item->amount = 1;
     item->type = ITEM_SCROLL;
-    item->id = latestItemId++; // give item random ID
-
-    int r = generate(1, 100);
-    if (r < 33) {
-        item->name = item->unknownName = "scroll of fire";
-        item->pluralName = "scrolls of fire";
-        item->potion = SCROLL_FIRE;
-    } else {
-        item->name = item->unknownName = "scroll of teleportation";
-        item->pluralName = "scrolls of teleportation";
-        item->potion = SCROLL_TELEPORT;
-    /* Not really useful until we generate random item names... */
-    /* } else { */
-    /*     item->name = item->unknownName = "scroll of identify"; */
-    /*     item->pluralName = "scrolls of identify"; */
-    /*     item->potion = SCROLL_IDENTIFY; */
-    }
+    item->id = next_item_id(game); // give item random ID
+
+    return item;
+}
+
+Item *scroll_of_fire(Game *game)
+{
+    Item *item = init_scroll(game);
+    item->name = item->unknownName = "scroll of fire";
+    item->pluralName = "scrolls of fire";
+    item->scroll = SCROLL_FIRE;
+
+    return item;
+}
+
+Item *scroll_of_teleportation(Game *game)
+{
+    Item *item = init_scroll(game);
+    item->name = item->unknownName = "scroll of teleportation";
+    item->pluralName = "scrolls of teleportation";
+    item->scroll = SCROLL_TELEPORT;
 
     return item;
 }
 
+/* Not really useful until we generate random item names... */
+/* Item *scroll_of_identify() */
+/* { */
+/*     Item *item = init_scroll(game); */
+/*     item->name = item->unknownName = "scroll of identify"; */
+/*     item->pluralName = "scrolls of identify"; */
+/*     item->scroll = SCROLL_IDENTIFY; */
+
+/*     return item; */
+/* } */
+
 
 /*************/
 /**         **/
@@ -179,7 +199,7 @@ Item *generate_scroll(int depth)
 /**         **/
 /*************/
 
-Item *init_armor()
+Item *init_armor(Game *game)
 {
     Item *item = malloc(sizeof(Item));
 
@@ -192,14 +212,14 @@ Item *init_armor()
     item->type = ITEM_ARMOR;
     item->amount = 1;
     item->armor.material = MATERIAL_METAL;
-    item->id = latestItemId++; // give item random ID
+    item->id = next_item_id(game); // give item random ID
 
     return item;
 }
 
-Item *leather()
+Item *leather(Game *game)
 {
-    Item *item = init_armor();
+    Item *item = init_armor(game);
     item->name = item->unknownName = "leather armor";
     item->armor.damageReduction = 1;
     item->armor.material = MATERIAL_LEATHER;
@@ -207,45 +227,45 @@ Item *leather()
     return item;
 }
 
-Item *ring_mail()
+Item *ring_mail(Game *game)
 {
-    Item *item = init_armor();
+    Item *item = init_armor(game);
     item->name = item->unknownName = "ring mail";
     item->armor.damageReduction = 2;
 
     return item;
 }
 
-Item *splint_mail()
+Item *splint_mail(Game *game)
 {
-    Item *item = init_armor();
+    Item *item = init_armor(game);
     item->name = item->unknownName = "splint mail";
     item->armor.damageReduction = 3;
 
     return item;
 }
 
-Item *plate_mail()
+Item *plate_mail(Game *game)
 {
-    Item *item = init_armor();
+    Item *item = init_armor(game);
     item->name = item->unknownName = "plate mail";
     item->armor.damageReduction = 4;
 
     return item;
 }
 
-Item *full_plate()
+Item *full_plate(Game *game)
 {
-    Item *item = init_armor();
+    Item *item = init_armor(game);
     item->name = item->unknownName = "full plate";
     item->armor.damageReduction = 5;
 
     return item;
 }
 
-Item *dragon_hide()
+Item *dragon_hide(Game *game)
 {
-    Item *item = init_armor();
+    Item *item = init_armor(game);
     item->name = item->unknownName = "dragon hide";
     item->armor.damageReduction = 6;
     item->armor.material = MATERIAL_DRAGON;
@@ -253,9 +273,9 @@ Item *dragon_hide()
     return item;
 }
 
-Item *dragon_plate()
+Item *dragon_plate(Game *game)
 {
-    Item *item = init_armor();
+    Item *item = init_armor(game);
     item->name = item->unknownName = "dragon plate";
     item->armor.damageReduction = 10;
     item->armor.material = MATERIAL_DRAGON;
@@ -263,57 +283,13 @@ Item *dragon_plate()
     return item;
 }
 
-Item *generate_armor(int depth)
-{
-    // percentile roll
-    int percent = generate(1, 100);
-
-    // TODO probably want to actually generate dragonhide on dragons
-
-    // generate different armor based on depth
-    if (depth <= 2)
-    {
-        if (percent <= 75)
-            return leather();
-        else
-            return ring_mail();
-    }
-    else if (depth <= 5)
-    {
-        if (percent <= 25)
-            return leather();
-        else if (percent <= 75)
-            return ring_mail();
-        else
-            return splint_mail();
-    }
-    else
-    {
-        if (percent <= 20)
-            return ring_mail();
-        else if (percent <= 35)
-            return splint_mail();
-        else if (percent <= 75)
-            return plate_mail();
-        else if (percent <= 85)
-            return full_plate();
-        else if (percent <= 95)
-            return dragon_hide();
-        else
-            return dragon_plate();
-    }
-
-    return NULL;
-}
-
-
 /*************/
 /**         **/
 /** weapons **/
 /**         **/
 /*************/
 
-Item *init_weapon()
+Item *init_weapon(Game *game)
 {
     Item *item = malloc(sizeof(Item));
 
@@ -328,14 +304,14 @@ Item *init_weapon()
     item->damage.type = WEAPON_SLASH;
     item->damage.min = 1;
     item->damage.range = 5;
-    item->id = latestItemId++; // give item random ID
+    item->id = next_item_id(game); // give item random ID
 
     return item;
 }
 
-Item *club()
+Item *club(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.max = 4;
     weapon->damage.type = WEAPON_BLUNT;
     weapon->name = weapon->unknownName = "club";
@@ -343,27 +319,27 @@ Item *club()
     return weapon;
 }
 
-Item *dagger()
+Item *dagger(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.max = 4;
     weapon->name = weapon->unknownName = "dagger";
 
     return weapon;
 }
 
-Item *short_sword()
+Item *short_sword(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.max = 6;
     weapon->name = weapon->unknownName = "short sword";
 
     return weapon;
 }
 
-Item *mace()
+Item *mace(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.max = 6;
     weapon->damage.type = WEAPON_BLUNT;
     weapon->name = weapon->unknownName = "club";
@@ -371,9 +347,9 @@ Item *mace()
     return weapon;
 }
 
-Item *quarterstaff()
+Item *quarterstaff(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.max = 6;
     weapon->damage.type = WEAPON_BLUNT & WEAPON_TWOHANDED;
     weapon->name = weapon->unknownName = "quarterstaff";
@@ -382,9 +358,9 @@ Item *quarterstaff()
     return weapon;
 }
 
-Item *long_sword()
+Item *long_sword(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.max = 8;
     weapon->damage.type &= WEAPON_TWOHANDED;
     weapon->name = weapon->unknownName = "long sword";
@@ -392,9 +368,9 @@ Item *long_sword()
     return weapon;
 }
 
-Item *bastard_sword()
+Item *bastard_sword(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.max = 10;
     weapon->damage.type &= WEAPON_TWOHANDED;
     weapon->name = weapon->unknownName = "bastard sword";
@@ -402,9 +378,9 @@ Item *bastard_sword()
     return weapon;
 }
 
-Item *flail()
+Item *flail(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.max = 8;
     weapon->damage.type = WEAPON_BLUNT;
     weapon->name = weapon->unknownName = "flail";
@@ -412,9 +388,9 @@ Item *flail()
     return weapon;
 }
 
-Item *masterwork_sword()
+Item *masterwork_sword(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.min = 2;
     weapon->damage.max = 10;
     weapon->name = weapon->unknownName = "masterwork sword";
@@ -422,9 +398,9 @@ Item *masterwork_sword()
     return weapon;
 }
 
-Item *masterwork_bastard_sword()
+Item *masterwork_bastard_sword(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.min = 2;
     weapon->damage.max = 12;
     weapon->name = weapon->unknownName = "masterwork bastard sword";
@@ -432,9 +408,9 @@ Item *masterwork_bastard_sword()
     return weapon;
 }
 
-Item *silver_sword()
+Item *silver_sword(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->damage.min = 2;
     weapon->damage.max = 10;
     weapon->damage.type = WEAPON_SILVER;
@@ -443,9 +419,9 @@ Item *silver_sword()
     return weapon;
 }
 
-Item *arrow()
+Item *arrow(Game *game)
 {
-    Item *weapon = init_weapon();
+    Item *weapon = init_weapon(game);
     weapon->type = ITEM_PROJECTILE;
     weapon->damage.min = 1;
     weapon->damage.max = 4;
@@ -455,52 +431,3 @@ Item *arrow()
 
     return weapon;
 }
-
-Item *generate_weapon(int depth)
-{
-    // percentile roll
-    int percent = generate(1, 100);
-
-    // TODO artifact/unique weapons
-
-    // generate different weapons based on depth
-    if (depth <= 2)
-    {
-        if (percent <= 50)
-            return dagger();
-        else if (percent <= 75)
-            return short_sword();
-        else
-            return quarterstaff();
-    }
-    else if (depth <= 5)
-    {
-        if (percent <= 20)
-            return dagger();
-        else if (percent <= 30)
-            return arrow();
-        else if (percent <= 50)
-            return mace();
-        else if (percent <= 75)
-            return long_sword();
-        else
-            return bastard_sword();
-    }
-    else
-    {
-        if (percent <= 20)
-            return arrow();
-        else if (percent <= 35)
-            return bastard_sword();
-        else if (percent <= 75)
-            return flail();
-        else if (percent <= 85)
-            return masterwork_sword();
-        else if (percent <= 95)
-            return masterwork_bastard_sword();
-        else
-            return silver_sword();
-    }
-
-    return NULL;
-}
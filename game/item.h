@@ -32,6 +32,9 @@
 
 #define PROJECTILE_ARROW 1
 
+// per-game context (see context.h)
+typedef struct Game_t Game;
+
 // for weapons
 typedef struct {
     int min;
@@ -62,14 +65,16 @@ typedef struct {
     };
 } Item;
 
+
 char item_symbol(int itemType);
 char item_menu_symbol(int itemNum); // signifies selection spot in inventory
 
 // calculate total amount of gold in inventory
 int total_gold(Item **items, int itemCount);
 
-// return a random item for the specified dungeon depth
-Item *create_item(int depth, int type);
+// return a random item for the specified dungeon depth, with the next
+// unique ID of game
+Item *create_item(Game *game, int depth, int type);
 
 // returns 1 if item is stackable
 int is_stackable(Item item);
@@ -77,25 +82,34 @@ int is_stackable(Item item);
 // TODO need to sort items by type for inventory management
 
 // specific armor generation functions
-Item *leather();
-Item *ring_mail();
-Item *splint_mail();
-Item *plate_mail();
-Item *full_plate();
-Item *dragon_hide();
-Item *dragon_plate();
+Item *leather(Game *game);
+Item *ring_mail(Game *game);
+Item *splint_mail(Game *game);
+Item *plate_mail(Game *game);
+Item *full_plate(Game *game);
+Item *dragon_hide(Game *game);
+Item *dragon_plate(Game *game);
 
 // specific weapon generation functions
-Item *club();
-Item *dagger();
-Item *short_sword();
-Item *mace();
-Item *quarterstaff();
-Item *long_sword();
-Item *bastard_sword();
-Item *flail();
-Item *masterwork_sword();
-Item *masterwork_bastard_sword();
-Item *silver_sword();
+Item *club(Game *game);
+Item *dagger(Game *game);
+Item *short_sword(Game *game);
+Item *mace(Game *game);
+Item *quarterstaff(Game *game);
+Item *long_sword(Game *game);
+Item *bastard_sword(Game *game);
+Item *flail(Game *game);
+Item *masterwork_sword(Game *game);
+Item *masterwork_bastard_sword(Game *game);
+Item *silver_sword(Game *game);
+Item *arrow(Game *game);
+
+// specific potion generation functions
+Item *healing_potion(Game *game);
+Item *acidic_potion(Game *game);
+
+// specific scroll generation functions
+Item *scroll_of_fire(Game *game);
+Item *scroll_of_teleportation(Game *game);
 
 #endif
@@ -0,0 +1,341 @@
+#include "journal.h"
+#include "game.h"
+#include "hash.h"
+#include "context.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Journal layout (native byte order):
+//
+//   JournalHeader
+//   records, each a uint8 tag followed by its payload (see JOURNAL tags)
+//
+// Only keys read from the player are recorded - turns spent resting or
+// running get their input from handle_input, so they replay by themselves.
+// The state hash after every gameloop call is recorded too, so replays can
+// find the first turn that played out differently.
+
+#define JOURNAL_MAGIC "SRLJ"
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t seed;
+    uint32_t width, height; // map size
+} JournalHeader;
+
+struct Journal_t {
+    FILE *file;
+    char buffer[JOURNAL_BUFFER_SIZE];
+};
+
+// journal being replayed
+typedef struct {
+    const unsigned char *data;
+    size_t length;
+    size_t offset;
+} JournalReader;
+
+// one decoded journal record
+typedef struct {
+    int tag; // one of JOURNAL tags
+    int key;
+    int32_t end[2]; // result & turn
+    uint64_t hash;
+} JournalRecord;
+
+Journal *open_journal(const char *filename, const Dungeon *dungeon)
+{
+    Journal *journal = malloc(sizeof(Journal));
+    if (journal == NULL)
+        return NULL;
+
+    journal->file = fopen(filename, "wb");
+    if (journal->file == NULL)
+    {
+        free(journal);
+
+        return NULL;
+    }
+    setvbuf(journal->file, journal->buffer, _IOFBF, JOURNAL_BUFFER_SIZE);
+
+    JournalHeader header = {0};
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.seed = dungeon->seed;
+    header.width = dungeon->width;
+    header.height = dungeon->height;
+    fwrite(&header, sizeof(header), 1, journal->file);
+
+    return journal;
+}
+
+void journal_key(Journal *journal, int key)
+{
+    if (journal == NULL)
+        return;
+
+    if (key >= 0 && key <= UINT8_MAX)
+    {
+        putc(JOURNAL_KEY, journal->file);
+        putc(key, journal->file);
+    }
+    else
+    {
+        int32_t wide = key;
+        putc(JOURNAL_WIDE_KEY, journal->file);
+        fwrite(&wide, sizeof(wide), 1, journal->file);
+    }
+}
+
+void journal_hash(Journal *journal, uint64_t hash)
+{
+    if (journal == NULL)
+        return;
+
+    putc(JOURNAL_HASH, journal->file);
+    fwrite(&hash, sizeof(hash), 1, journal->file);
+}
+
+void flush_journal(Journal *journal)
+{
+    if (journal)
+        fflush(journal->file);
+}
+
+void close_journal(Journal *journal, int result, int turn)
+{
+    if (journal == NULL)
+        return;
+
+    int32_t end[2] = { result, turn };
+    putc(JOURNAL_END, journal->file);
+    fwrite(end, sizeof(end), 1, journal->file);
+
+    fclose(journal->file);
+    free(journal);
+}
+
+/*************/
+/**         **/
+/** private **/
+/**         **/
+/*************/
+
+// read whole file into memory
+// returns NULL on error
+unsigned char *read_journal(const char *filename, size_t *length)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+        return NULL;
+
+    unsigned char *data = NULL;
+    long size;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        data = malloc(size ? size : 1);
+        if (data && fread(data, 1, size, file) != (size_t) size)
+        {
+            free(data);
+            data = NULL;
+        }
+        *length = size;
+    }
+    fclose(file);
+
+    return data;
+}
+
+// copy size bytes of record payload
+// returns 0 if the record is truncated
+int read_payload(JournalReader *r, void *payload, size_t size)
+{
+    if (size > r->length - r->offset)
+        return 0;
+
+    memcpy(payload, r->data + r->offset, size);
+    r->offset += size;
+
+    return 1;
+}
+
+// decode next record
+// returns 0 at end of journal, or on an unknown or truncated record
+int read_record(JournalReader *r, JournalRecord *record)
+{
+    if (r->offset >= r->length)
+        return 0;
+
+    record->tag = r->data[r->offset++];
+    if (record->tag == JOURNAL_KEY)
+    {
+        uint8_t key;
+        if (!read_payload(r, &key, sizeof(key)))
+            return 0;
+        record->key = key;
+
+        return 1;
+    }
+    else if (record->tag == JOURNAL_WIDE_KEY)
+    {
+        int32_t key;
+        if (!read_payload(r, &key, sizeof(key)))
+            return 0;
+        record->key = key;
+
+        return 1;
+    }
+    else if (record->tag == JOURNAL_END)
+        return read_payload(r, record->end, sizeof(record->end));
+    else if (record->tag == JOURNAL_HASH)
+        return read_payload(r, &record->hash, sizeof(record->hash));
+
+    return 0;
+}
+
+// read next key, skipping hash records
+// returns 0 at end of journal (stats are updated from the end record)
+int next_key(JournalReader *r, int *key, ReplayStats *stats)
+{
+    JournalRecord record;
+    while (read_record(r, &record))
+    {
+        if (record.tag == JOURNAL_KEY || record.tag == JOURNAL_WIDE_KEY)
+        {
+            *key = record.key;
+
+            return 1;
+        }
+        else if (record.tag == JOURNAL_END)
+        {
+            stats->expectedResult = record.end[0];
+            stats->expectedTurns = record.end[1];
+
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+// compare state hash with the hash recorded after the same turn, if any
+// returns 0 if the replay diverged
+int verify_hash(JournalReader *r, const Game *game, const Dungeon *dungeon, ReplayStats *stats)
+{
+    JournalRecord record;
+    size_t offset = r->offset;
+    if (!read_record(r, &record) || record.tag != JOURNAL_HASH)
+    {
+        r->offset = offset; // not a hash, leave it for next_key
+
+        return 1;
+    }
+
+    ++stats->hashes;
+    uint64_t hash = state_hash(game, dungeon);
+    if (hash == record.hash)
+        return 1;
+
+    stats->divergedTurn = dungeon->turn;
+    stats->expectedHash = record.hash;
+    stats->replayedHash = hash;
+    stats->hashMismatch = hash != full_hash(game, dungeon);
+
+    return 0;
+}
+
+double elapsed_seconds(struct timespec start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int replay_journal(const char *filename, int verify, ReplayStats *stats)
+{
+    size_t length = 0;
+    unsigned char *data = read_journal(filename, &length);
+    if (data == NULL)
+        return 0;
+
+    JournalHeader header;
+    if (length < sizeof(header))
+    {
+        free(data);
+
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) || header.version != JOURNAL_VERSION ||
+            header.width < MIN_MAP_SIZE || header.width > MAX_MAP_SIZE ||
+            header.height < MIN_MAP_SIZE || header.height > MAX_MAP_SIZE)
+    {
+        free(data);
+
+        return 0;
+    }
+
+    *stats = (ReplayStats) {0};
+    stats->result = GAME_PLAYING;
+    stats->expectedResult = -1;
+    stats->expectedTurns = -1;
+    stats->divergedTurn = -1;
+
+    // same setup as a new game in main
+    Game *game = create_game();
+    if (game)
+    {
+        game->mapWidth = header.width;
+        game->mapHeight = header.height;
+    }
+    Dungeon *dungeon = game ? create_dungeon(game, header.seed) : NULL;
+    if (dungeon == NULL || !init_level(game, dungeon->level, dungeon->player))
+    {
+        destroy_game(game);
+        free(data);
+        stats->result = GAME_OOM;
+
+        return 1;
+    }
+    update_fov(dungeon->level);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    JournalReader r = { data, length, sizeof(header) };
+    int input;
+    while (stats->result == GAME_PLAYING)
+    {
+        if (handle_input(game, dungeon))
+        {
+            if (!next_key(&r, &input, stats))
+                break; // journal ended with the game still running
+            ++stats->keys;
+        }
+        else
+            input = '.';
+
+        stats->result = gameloop(game, dungeon, input);
+
+        if (verify && !verify_hash(&r, game, dungeon, stats))
+            break;
+    }
+
+    stats->seconds = elapsed_seconds(start);
+    stats->turns = dungeon->turn;
+
+    // pick up the end record after the last key
+    if (stats->result != GAME_PLAYING)
+        next_key(&r, &input, stats);
+
+    destroy_dungeon(dungeon);
+    destroy_game(game);
+    free(data);
+
+    return 1;
+}
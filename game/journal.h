@@ -0,0 +1,54 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#define JOURNAL_VERSION     2
+#define JOURNAL_BUFFER_SIZE 4096 // bytes buffered before each write
+
+// journal record tags
+#define JOURNAL_KEY      1 // key passed to gameloop (uint8)
+#define JOURNAL_WIDE_KEY 2 // curses key passed to gameloop (int32)
+#define JOURNAL_END      3 // game result & final turn (int32, int32)
+#define JOURNAL_HASH     4 // state_hash after gameloop (uint64)
+
+#include "dungeon.h"
+#include <stdint.h>
+
+// seed, map size & keystrokes of one game, enough to play it back exactly
+typedef struct Journal_t Journal;
+
+// stats of a replayed journal
+typedef struct {
+    int result; // GAME constant of the replay
+    int turns;
+    int keys; // keys read from journal
+    double seconds; // time spent in the game loop
+    int expectedResult, expectedTurns; // recorded at end of game, -1 if missing
+    int hashes; // state hashes verified
+    int divergedTurn; // first turn with a different state hash, -1 if none
+    uint64_t expectedHash, replayedHash; // hashes of diverged turn
+    int hashMismatch; // 1 if the replayed incremental hash doesn't match a full rehash
+} ReplayStats;
+
+// start journal of a new game with the seed & map size of dungeon
+// returns NULL on error
+Journal *open_journal(const char *filename, const Dungeon *dungeon);
+
+// append key read from the player
+void journal_key(Journal *journal, int key);
+
+// append state hash of the turn that was just played
+void journal_hash(Journal *journal, uint64_t hash);
+
+// write buffered records to disk (i.e. before blocking on input)
+void flush_journal(Journal *journal);
+
+// record the game result & close the journal
+void close_journal(Journal *journal, int result, int turn);
+
+// play the journaled game without rendering, as fast as possible
+// if verify is set, the replay stops at the first turn whose state hash
+// differs from the recorded one
+// returns 0 if the journal could not be read
+int replay_journal(const char *filename, int verify, ReplayStats *stats);
+
+#endif
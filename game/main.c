@@ -1,6 +1,13 @@
 #include "draw.h"
 #include "game.h"
 #include "message.h"
+#include "table.h"
+#include "save.h"
+#include "journal.h"
+#include "hash.h"
+#include "context.h"
+#include "bot.h"
+#include "recording.h"
 
 #define RL_IMPLEMENTATION
 #include "lib/roguelike.h"
@@ -10,75 +17,497 @@
 #include <stdlib.h>
 #include <memory.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
 
 #define ERROR_OOM 1  // out of memory error
 #define ERROR_INIT 2 // curses initialization error
 #define ERROR_GAME 3 // internal game error
 
+#define BOT_DELAY     50    // ms between bot moves when watching it play
+#define BOT_MAX_TURNS 20000 // headless bot games still running after this are stopped
+
+#define PLAYBACK_SPEED 10   // turns per second
+#define PLAYBACK_SKIP  100  // turns skipped by n & p
+#define PLAYBACK_WAIT  1000 // max ms between frames, i.e. while resting
+
 int usage()
 {
-    printf("Usage: simplerl [--no-color]\n");
+    printf("Usage: simplerl [--no-color] [--autosave] [--size WxH] [--journal FILE] [--replay FILE [--verify]] [--bot [--headless] [--games N]] [--record FILE] [--play FILE [--turn N] [--speed X]]\n");
+    printf("\n");
+    printf("  --size WxH      start a new game on levels of W by H tiles (default %dx%d, %d to %d each)\n", MAX_WIDTH, MAX_HEIGHT, MIN_MAP_SIZE, MAX_MAP_SIZE);
+    printf("  --journal FILE  record seed & keys of a new game to FILE\n");
+    printf("  --replay FILE   play back a journal without rendering & report turns per second\n");
+    printf("  --verify        check the state hash of every replayed turn against the journal\n");
+    printf("  --bot           let the built-in bot play, press Q to quit or S to save\n");
+    printf("  --headless      play bot games without a terminal & report turns per second\n");
+    printf("  --games N       play N bot games back to back\n");
+    printf("  --record FILE   record the screen of a new game to FILE\n");
+    printf("  --play FILE     watch a recording, press q to quit, space to pause, +/- to change speed or n/p to skip %d turns\n", PLAYBACK_SKIP);
+    printf("  --turn N        start watching at turn N\n");
+    printf("  --speed X       watch X turns per second (default %d)\n", PLAYBACK_SPEED);
 
     return 99;
 }
 
-int main(int argc, const char **argv)
+// play back journal headlessly & print replay stats
+int replay(const char *filename, int verify)
 {
-    int enableColor = 1;
-    if (argc > 1 && strcmp(argv[1], "--no-color") == 0)
-        enableColor = 0;
-    if (argc > 1 && (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")))
-        return usage();
+    init_tables();
 
-    // initialize curses
-    if (!init(enableColor)) {
-        fprintf(stderr, "ERROR: Terminal size too small. The game requires a terminal of at least %d characters wide by %d characters tall.\n", MAX_WIDTH, MAX_HEIGHT);
-        return ERROR_INIT;
+    ReplayStats stats;
+    if (!replay_journal(filename, verify, &stats))
+    {
+        fprintf(stderr, "ERROR: Unable to read journal %s.\n", filename);
+
+        return ERROR_GAME;
     }
 
-    // initialize dungeon
-    unsigned long seed = time(0);
-    Dungeon *dungeon = create_dungeon(seed);
-    if (dungeon == NULL)
-        return ERROR_OOM;
+    printf("Replayed %d keys over %d turns in %.3f seconds (%.0f turns per second).\n",
+            stats.keys,
+            stats.turns,
+            stats.seconds,
+            stats.seconds > 0 ? stats.turns / stats.seconds : 0);
 
-    // allocate messages array
-    if (!init_messages())
-        return ERROR_OOM;
+    if (stats.divergedTurn != -1)
+    {
+        printf("Replay diverged on turn %d: recorded state hash %016llx, replayed %016llx%s.\n",
+                stats.divergedTurn,
+                (unsigned long long) stats.expectedHash,
+                (unsigned long long) stats.replayedHash,
+                stats.hashMismatch ? " (incremental hash is out of date)" : "");
 
-    // randomize initial level
-    if (!init_level(dungeon->level, dungeon->player))
+        return ERROR_GAME;
+    }
+    else if (verify)
+        printf("Verified %d state hashes.\n", stats.hashes);
+
+    if (stats.expectedResult == -1)
+        printf("Journal has no end record, game was still running after turn %d.\n", stats.turns);
+    else if (stats.result != stats.expectedResult || stats.turns != stats.expectedTurns)
+    {
+        printf("Replay diverged: recorded result %d on turn %d, replayed result %d on turn %d.\n",
+                stats.expectedResult,
+                stats.expectedTurns,
+                stats.result,
+                stats.turns);
+
+        return ERROR_GAME;
+    }
+    else
+        printf("Replay matches the recorded result %d on turn %d.\n", stats.result, stats.turns);
+
+    return stats.result == GAME_OOM ? ERROR_OOM : 0;
+}
+
+// watch recording from turn
+int watch(const char *filename, int turn, double speed, int enableColor)
+{
+    Game *game = create_game();
+    if (game == NULL)
         return ERROR_OOM;
-    render(dungeon);
 
-    // update initial FOV
-    rl_fov_calculate(dungeon->level->fov, dungeon->level->map, dungeon->player->coords.x, dungeon->player->coords.y, FOV_RADIUS);
+    int result = 0;
+    Playback *playback = open_playback(filename);
+    if (playback == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to read recording %s.\n", filename);
+        result = ERROR_GAME;
+        goto done;
+    }
+
+    // recordings are always the full MAX_WIDTH by MAX_HEIGHT
+    int initialized = init(game, enableColor);
+    if (initialized && (game->viewWidth < MAX_WIDTH || game->viewHeight < MAX_HEIGHT)) {
+        deinit();
+        initialized = 0;
+    }
+    if (!initialized) {
+        fprintf(stderr, "ERROR: Terminal size too small. Playback requires a terminal of at least %d characters wide by %d characters tall.\n", MAX_WIDTH, MAX_HEIGHT + MAX_MESSAGES);
+        result = ERROR_INIT;
+        goto done;
+    }
+
+    result = seek_playback(playback, turn) ? 0 : ERROR_GAME;
+    int paused = 0;
+    while (result == 0)
+    {
+        render_tiles(game, playback->tiles, playback->text);
+        mvprintw(MAX_HEIGHT + MAX_MESSAGES, 0, "Turn %d / %d at %g turns per second%s",
+                playback->turn,
+                playback->lastTurn,
+                speed,
+                paused ? " (paused)" : "");
+        clrtoeol();
+        refresh();
+
+        // wait until the next frame is due
+        int next = next_playback_turn(playback);
+        int delay = -1;
+        if (!paused && next != -1)
+        {
+            delay = (next - playback->turn) * 1000 / speed;
+            if (delay > PLAYBACK_WAIT)
+                delay = PLAYBACK_WAIT;
+        }
+        timeout(delay);
+
+        int input = getch();
+        if (input == ERR)
+        {
+            if (!next_playback_frame(playback) && next != -1)
+                result = ERROR_GAME;
+        }
+        else if (input == 'q' || input == 'Q')
+            break;
+        else if (input == ' ')
+            paused = !paused;
+        else if (input == '+')
+            speed *= 2;
+        else if (input == '-' && speed > 1)
+            speed /= 2;
+        else if (input == 'n' && !seek_playback(playback, playback->turn + PLAYBACK_SKIP))
+            result = ERROR_GAME;
+        else if (input == 'p' && !seek_playback(playback, playback->turn - PLAYBACK_SKIP))
+            result = ERROR_GAME;
+    }
+
+    deinit();
+    if (result != 0)
+        fprintf(stderr, "ERROR: Recording %s is broken after turn %d.\n", filename, playback->turn);
+
+done:
+    close_playback(playback);
+    destroy_game(game);
+
+    return result;
+}
+
+// play dungeon until the game is over
+// input comes from the keyboard, or from bot if given (the keyboard can
+// still quit or save), headless games are never drawn
+int play(Game *game, Dungeon *dungeon, Bot *bot, int headless, Journal *journal, Recording *recording)
+{
+    if (bot && !headless)
+        timeout(BOT_DELAY);
 
     int result = GAME_PLAYING;
     int input;
     while (result == GAME_PLAYING)
     {
         // render & update curses
-        render(dungeon);
+        if (headless)
+            render_frame(game, dungeon);
+        else
+            render(game, dungeon);
+        record_frame(recording, game, dungeon);
 
-        if (handle_input(dungeon))
-            input = getch();
+        if (handle_input(game, dungeon))
+        {
+            flush_journal(journal);
+            input = headless ? ERR : getch();
+            if (bot && input != 'Q' && input != 'S')
+                input = bot_input(bot, game, dungeon);
+            journal_key(journal, input);
+        }
         else
             input = '.';
 
         // trigger gameloop
-        result = gameloop(dungeon, input);
+        result = gameloop(game, dungeon, input);
+        journal_hash(journal, state_hash(game, dungeon));
+
+        if (bot && headless && dungeon->turn >= BOT_MAX_TURNS)
+            break;
+    }
+
+    if (bot && !headless)
+        timeout(-1);
+
+    return result;
+}
+
+double elapsed(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// let the bot play games back to back, i.e. to soak test & measure
+// throughput, & print totals
+int autoplay(int games, int headless, int enableColor, unsigned int width, unsigned int height)
+{
+    int error = 0, terminal = 0;
+    Dungeon *dungeon = NULL;
+    Game *game = create_game();
+    Bot *bot = malloc(sizeof(Bot));
+    if (bot)
+        init_bot(bot, 0);
+    if (game == NULL || bot == NULL)
+    {
+        error = ERROR_OOM;
+        goto done;
     }
+    game->mapWidth = width;
+    game->mapHeight = height;
+
+    if (!headless && !init(game, enableColor)) {
+        fprintf(stderr, "ERROR: Terminal size too small. The game requires a terminal of at least %d characters wide by %d characters tall.\n", MIN_VIEW_WIDTH, MIN_VIEW_HEIGHT + MAX_MESSAGES);
+        error = ERROR_INIT;
+        goto done;
+    }
+    terminal = !headless;
+
+    init_tables();
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    unsigned long seed = time(0);
+    long turns = 0;
+    size_t levelBytes = 0;
+    int levels = 0;
+    int played = 0, died = 0, won = 0, stopped = 0;
+    int result = GAME_PLAYING;
+    for (; played < games && result != GAME_QUIT && result != GAME_SAVE; ++played)
+    {
+        reset_game(game);
+        dungeon = create_dungeon(game, seed + played);
+        if (dungeon == NULL || !init_level(game, dungeon->level, dungeon->player))
+        {
+            error = ERROR_OOM;
+            goto done;
+        }
+        update_fov(dungeon->level);
+        init_bot(bot, dungeon->seed);
+
+        result = play(game, dungeon, bot, headless, NULL, NULL);
+        destroy_bot(bot);
+        if (result == GAME_OOM)
+            error = ERROR_OOM;
+        else if (result == GAME_ERROR)
+            error = ERROR_GAME;
+        else if (result == GAME_DEATH)
+            ++died;
+        else if (result == GAME_WON)
+            ++won;
+        else if (result == GAME_PLAYING)
+            ++stopped;
+        if (error)
+            goto done;
+
+        turns += dungeon->turn;
+        Level *level = dungeon->level;
+        while (level->next)
+            level = level->next;
+        for (; level; level = level->prev, ++levels)
+            levelBytes += level_bytes(level);
+        destroy_dungeon(dungeon);
+        dungeon = NULL;
+    }
+    double seconds = elapsed(&start);
+
+    if (terminal)
+        deinit();
+    terminal = 0;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("Bot played %d games (seeds %lu - %lu): died %d, won %d, stopped after %d turns %d.\n",
+            played, seed, seed + played - 1, died, won, BOT_MAX_TURNS, stopped);
+    printf("Played %ld turns in %.3f seconds (%.0f turns per second), max RSS %ld kB.\n",
+            turns,
+            seconds,
+            seconds > 0 ? turns / seconds : 0,
+            usage.ru_maxrss);
+    printf("Levels used %zu kB each on average.\n", levels ? levelBytes / levels / 1024 : 0);
+
+done:
+    if (terminal)
+        deinit();
+    if (bot)
+        destroy_bot(bot);
+    free(bot);
+    if (dungeon)
+        destroy_dungeon(dungeon);
+    if (game)
+        destroy_game(game);
+
+    return error;
+}
+
+int main(int argc, const char **argv)
+{
+    int enableColor = 1;
+    int enableAutosave = 0;
+    const char *journalFile = NULL;
+    const char *replayFile = NULL;
+    int verifyReplay = 0;
+    int enableBot = 0;
+    int headless = 0;
+    int games = 0;
+    const char *recordFile = NULL;
+    const char *playFile = NULL;
+    int playTurn = 0;
+    double playSpeed = PLAYBACK_SPEED;
+    unsigned int mapWidth = MAX_WIDTH, mapHeight = MAX_HEIGHT;
+    int sized = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--no-color") == 0)
+            enableColor = 0;
+        else if (strcmp(argv[i], "--autosave") == 0)
+            enableAutosave = 1;
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &mapWidth, &mapHeight) != 2 ||
+                    mapWidth < MIN_MAP_SIZE || mapWidth > MAX_MAP_SIZE ||
+                    mapHeight < MIN_MAP_SIZE || mapHeight > MAX_MAP_SIZE)
+                return usage();
+            sized = 1;
+        }
+        else if (strcmp(argv[i], "--journal") == 0 && i + 1 < argc)
+            journalFile = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayFile = argv[++i];
+        else if (strcmp(argv[i], "--verify") == 0)
+            verifyReplay = 1;
+        else if (strcmp(argv[i], "--bot") == 0)
+            enableBot = 1;
+        else if (strcmp(argv[i], "--headless") == 0)
+            headless = 1;
+        else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+            games = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordFile = argv[++i];
+        else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc)
+            playFile = argv[++i];
+        else if (strcmp(argv[i], "--turn") == 0 && i + 1 < argc)
+            playTurn = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+            playSpeed = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+            return usage();
+    }
+
+    if (replayFile)
+        return replay(replayFile, verifyReplay);
+    if (playFile)
+        return playSpeed > 0 ? watch(playFile, playTurn, playSpeed, enableColor) : usage();
+
+    // headless & repeated games are for the bot only
+    if (!enableBot && (headless || games))
+        return usage();
+    if (enableBot && (headless || games))
+        return autoplay(games > 0 ? games : 1, headless, enableColor, mapWidth, mapHeight);
+
+    // allocate game context (messages, menus & screen buffer)
+    Game *game = create_game();
+    if (game == NULL)
+        return ERROR_OOM;
+    game->mapWidth = mapWidth;
+    game->mapHeight = mapHeight;
+
+    // initialize curses
+    if (!init(game, enableColor)) {
+        fprintf(stderr, "ERROR: Terminal size too small. The game requires a terminal of at least %d characters wide by %d characters tall.\n", MIN_VIEW_WIDTH, MIN_VIEW_HEIGHT + MAX_MESSAGES);
+        return ERROR_INIT;
+    }
+
+    // build spawn & loot tables
+    init_tables();
+
+    // resume saved game (save is removed once loaded), or initialize dungeon
+    // journals, recordings, the bot & another map size need to start from a
+    // new game
+    Dungeon *dungeon = journalFile || recordFile || enableBot || sized ? NULL : load_dungeon(game, SAVE_FILE);
+    if (dungeon != NULL)
+    {
+        unlink(SAVE_FILE);
+        message(game, "Welcome back!");
+    }
+    else
+    {
+        dungeon = create_dungeon(game, time(0));
+        if (dungeon == NULL)
+            return ERROR_OOM;
+
+        // randomize initial level
+        if (!init_level(game, dungeon->level, dungeon->player))
+            return ERROR_OOM;
+    }
+    render(game, dungeon);
+
+    // record seed & keys so the game can be replayed
+    Journal *journal = NULL;
+    if (journalFile)
+    {
+        journal = open_journal(journalFile, dungeon);
+        if (journal == NULL)
+            message(game, "Unable to open journal %s.", journalFile);
+    }
+    Recording *recording = NULL;
+    if (recordFile)
+    {
+        recording = open_recording(recordFile, dungeon->seed);
+        if (recording == NULL)
+            message(game, "Unable to open recording %s.", recordFile);
+    }
+
+    // autosave in the background while playing
+    if (enableAutosave)
+        set_autosave(game, SAVE_FILE);
+
+    // generate levels in the background, so taking the stairs doesn't stall
+    dungeon->pregenerate = 1;
+
+    // update initial FOV
+    update_fov(dungeon->level);
+
+    Bot bot;
+    if (enableBot)
+        init_bot(&bot, dungeon->seed);
+
+    int result = play(game, dungeon, enableBot ? &bot : NULL, 0, journal, recording);
+    if (enableBot)
+        destroy_bot(&bot);
 
     // de-initialize curses
     deinit();
 
+    close_journal(journal, result, dungeon->turn);
+    close_recording(recording);
+
+    // wait for last autosave, it is stale unless we're saving
+    finish_autosave(game);
+    if (enableAutosave && result != GAME_SAVE)
+        unlink(SAVE_FILE);
+
     if (result == GAME_WON)
         printf("You won!\n");
     else if (result == GAME_QUIT)
         printf("You quit.\n");
     else if (result == GAME_DEATH)
+    {
         printf("Oh no, you died :(\n");
+        if (game->killer)
+            printf("You were killed by the %s.\n", mob_name(game->killer));
+    }
+    else if (result == GAME_SAVE)
+    {
+        if (!save_dungeon(game, dungeon, SAVE_FILE))
+        {
+            fprintf(stderr, "ERROR: Unable to save game to %s.\n", SAVE_FILE);
+
+            return ERROR_GAME;
+        }
+        printf("Game saved.\n");
+
+        return 0;
+    }
     else if (result == GAME_OOM)
         return ERROR_OOM;
     else if (result == GAME_ERROR)
@@ -88,14 +517,19 @@ int main(int argc, const char **argv)
 
     // print some things that might be interesting to the user
     printf("\n");
-    print_mob_list(dungeon->killed);
+    print_mob_list(&dungeon->kills);
+    if (dungeon->kills.total > 0)
+        printf("You killed %d %s for %d exp.\n",
+                dungeon->kills.total,
+                dungeon->kills.total == 1 ? "monster" : "monsters",
+                dungeon->kills.exp);
     printf("\n");
     printf("You reached dungeon level %d. Your player was level %d and collected %d gold.\n\n",
             max_depth(dungeon),
             dungeon->player->attrs.level,
-            total_gold(dungeon->player->items, dungeon->player->itemCount));
+            total_gold(dungeon->player->inventory->items, dungeon->player->inventory->itemCount));
 
-    printf("Seed: %zu\n", seed);
+    printf("Seed: %zu\n", dungeon->seed);
 
     return 0;
 }
@@ -1,72 +1,48 @@
 #include "message.h"
+#include "context.h"
 #include <stdlib.h>
 #include <memory.h>
 
-static const char **messages;
-
-bool init_messages()
+const char *get_message(const Game *game, int index)
 {
-    messages = malloc(sizeof(char*) * MAX_MESSAGE_LENGTH * MAX_MESSAGES);
+    if (index < 0 || index >= game->messageCount)
+        return NULL;
 
-    return messages;
+    return game->messages[(game->latestMessage - index + MAX_MESSAGES) % MAX_MESSAGES];
 }
 
-const char *get_message(int index)
+void clear_messages(Game *game)
 {
-    return messages[index];
+    game->messageCount = 0;
+    game->latestMessage = 0;
 }
 
-bool insert_message(const char *message, const char **messages)
+int vsnprintf(char *str, size_t size, const char *format, va_list ap); // FIXME this shouldn't be necessary...
+int message(Game *game, const char *fmt, ...)
 {
-    if (message == NULL)
-        return 1;
+    // write over the oldest message, messages are a ring so nothing needs
+    // to be allocated or moved
+    int slot = (game->latestMessage + 1) % MAX_MESSAGES;
+    char *buffer = game->messages[slot];
 
-    // free the last message
-    if (messages[MAX_MESSAGES-1])
-    {
-        free((char*) messages[MAX_MESSAGES-1]);
-    }
-
-    // rotate all messages up one index
-    for (int i = MAX_MESSAGES-1; i > 0; --i)
-    {
-        messages[i] = messages[i - 1];
-    }
+    va_list args;
+    va_start(args, fmt);
 
-    // insert message at index 0
-    messages[0] = message;
+    int bytes = vsnprintf(buffer, MAX_MESSAGE_LENGTH + 1, fmt, args);
 
-    return 0;
-}
-
-int vsnprintf(char *str, size_t size, const char *format, va_list ap); // FIXME this shouldn't be necessary...
-const char *create_message(const char *fmt, va_list args)
-{
-    char *message;
-    message = malloc(MAX_MESSAGE_LENGTH + 1);
-    memset((char*) message, 0, MAX_MESSAGE_LENGTH + 1);
-
-    int bytes = vsnprintf(message, MAX_MESSAGE_LENGTH + 1, fmt, args);
+    va_end(args);
 
-    if (bytes > MAX_MESSAGE_LENGTH + 1)
+    if (bytes < 0 || bytes > MAX_MESSAGE_LENGTH + 1)
     {
         // error! can't reserve more than max message length
-        free(message);
+        buffer[0] = '\0';
 
-        return NULL;
+        return 1;
     }
 
-    return message;
-}
-
-int message(const char *fmt, ...)
-{
-    va_list args;
-    va_start(args, fmt);
-
-    const char *msg = create_message(fmt, args);
+    game->latestMessage = slot;
+    if (game->messageCount < MAX_MESSAGES)
+        ++game->messageCount;
 
-    va_end(args);
-
-    return insert_message(msg, messages);
+    return 0;
 }
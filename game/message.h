@@ -4,19 +4,22 @@
 #define MAX_MESSAGE_LENGTH 80
 #define MAX_MESSAGES 5
 
+#include "item.h"
 #include <stdarg.h>
 #include <stdbool.h>
 
 // TODO debug (printf) macro
 // #ifdef DEBUG printf ???
 
-// get a message at specified index
-const char *get_message(int index);
+// get a message of game at specified index (0 is newest), NULL if there
+// are fewer messages
+const char *get_message(const Game *game, int index);
 
-// initialize message buffer
-bool init_messages();
+// forget all messages of game
+void clear_messages(Game *game);
 
-// simple function to reserve memory for message and insert it into message list
-int message(const char *fmt, ...);
+// format message & insert it into message list, dropping the oldest
+// returns 1 if the message is too long
+int message(Game *game, const char *fmt, ...);
 
 #endif
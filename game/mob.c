@@ -1,11 +1,18 @@
 #include "mob.h"
 #include "random.h"
+#include "table.h"
+#include "hash.h"
+#include "context.h"
 #include <stdlib.h>
 #include <memory.h>
+#include <assert.h>
 
-Mob *enemy(int hp, int minDamage, int maxDamage, char symbol, int form);
-Mob *create_mob(int depth, RL_Point coords)
+Mob enemy(int hp, int minDamage, int maxDamage, char symbol, int form);
+Item *give_loot(Game *game, Mob *m, int depth, int type);
+Mob create_mob(Game *game, int depth, RL_Point coords, RNG *rng)
 {
+    // pick species & difficulty from the spawn table
+    //
     // difficulty ranges
     //
     // level 1: 1 - 2
@@ -14,178 +21,285 @@ Mob *create_mob(int depth, RL_Point coords)
     // level 5: 5 - 10
     // level 7: 7 - 14
     // level 10: 10 - 20
-    int difficulty = generate(depth, depth*2);
-
-    Mob *m;
-
-    if (difficulty == 1)
-        m = enemy(4, 1, 2, 'r', MOB_FORM_QUADRAPED); // rat
-    else if (difficulty == 2)
-        m = enemy(4, 2, 3, 'k', MOB_FORM_BIPED); // kobold
-    else if (difficulty == 3)
-        m = enemy(5, 2, 3, 'g', MOB_FORM_BIPED); // goblin
-    else if (difficulty <= 5)
-        m = enemy(6, 2, 4, 'o', MOB_FORM_BIPED); // orc
-    else if (difficulty <= 7)
-        m = enemy(8, 3, 4, 'h', MOB_FORM_BIPED); // hobgoblin
-    else if (difficulty <= 9)
-        m = enemy(12, 4, 8, 'O', MOB_FORM_BIPED); // ogre
-    else if (difficulty <= 14)
-        m = enemy(15, 8, 12, 'd', MOB_FORM_QUADRAPED & MOB_FORM_FLYING); // drake
-    else if (difficulty <= 18)
-    {
-        m = enemy(20, 12, 15, 'D', MOB_FORM_QUADRAPED & MOB_FORM_FLYING); // dragon
+    Spawn spawn = sample_spawn(depth, rng);
+    const SpawnEntry *species = spawn.species;
 
-        // OOM check
-        if (m == NULL)
-            return NULL;
+    Mob m = enemy(species->hp, species->minDamage, species->maxDamage, species->symbol, species->form);
+    m.type = species->type;
+    m.depth = depth;
 
-        m->type = MOB_DRAGON;
-        // TODO breath effects
-        // TODO dragons always have dragonhide
+    if (m.form & MOB_FORM_BIPED)
+    {
+        // roll gold, weapon, armor & potion or scroll at once - items are
+        // only created once they matter (see materialize_loot)
+        m.loot.depth = depth;
+        m.loot.kit = LOOT_GOLD | sample_loot_kit(spawn.difficulty, rng);
     }
-    else
+
+    m.difficulty = spawn.difficulty;
+    m.coords = coords;
+
+    // mob wanders with its own stream, so AI doesn't shift other rolls
+    uint64_t high = next_random(rng);
+    uint64_t low = next_random(rng);
+    m.rng = split_stream(game->random.seed, RNG_MOB, (high << 32) | low);
+
+    return m;
+}
+
+void destroy_mob(Mob *mob)
+{
+    release_mob_path(mob);
+
+    free(mob->inventory);
+    mob->inventory = NULL;
+}
+
+int clone_mob(Mob *clone, const Mob *mob)
+{
+    *clone = *mob;
+    clone->inventory = NULL;
+
+    if (mob->path)
+        atomic_fetch_add(&mob->path->refs, 1);
+
+    const Inventory *inventory = mob->inventory;
+    if (inventory == NULL)
+        return 1;
+
+    Inventory *copy = malloc(sizeof(Inventory) + inventory->capacity*sizeof(Item*));
+    if (copy == NULL)
+        return 0;
+    copy->itemCount = 0;
+    copy->capacity = inventory->capacity;
+    copy->equipment = (Equipment) {0};
+    clone->inventory = copy;
+
+    for (int i = 0; i < inventory->itemCount; ++i)
     {
-        m = enemy(30, 15, 20, '&', MOB_FORM_BIPED & MOB_FORM_FLYING); // demon
+        Item *item = malloc(sizeof(Item));
+        if (item == NULL)
+            return 0;
+        *item = *inventory->items[i];
+        copy->items[copy->itemCount++] = item;
+
+        // equip the copies of equipped items
+        if (inventory->equipment.weapon == inventory->items[i])
+            copy->equipment.weapon = item;
+        if (inventory->equipment.armor == inventory->items[i])
+            copy->equipment.armor = item;
+        if (inventory->equipment.readied == inventory->items[i])
+            copy->equipment.readied = item;
+    }
 
-        // OOM check
-        if (m == NULL)
-            return NULL;
+    return 1;
+}
 
-        m->type = MOB_DEMON;
-        // TODO drain effects
-        // TODO demons always have cool sword
+void score_mob_path(Mob *mob, RL_Map *map, RL_Point target)
+{
+    if (mob->path && atomic_load(&mob->path->refs) > 1)
+        release_mob_path(mob); // leave the shared graph to the clone(s)
+
+    // only the map around mob & target is scored, so paths on big maps
+    // don't cost the whole map
+    int left = (mob->coords.x < target.x ? mob->coords.x : target.x) - MOB_PATH_MARGIN;
+    int top = (mob->coords.y < target.y ? mob->coords.y : target.y) - MOB_PATH_MARGIN;
+    int right = (mob->coords.x > target.x ? mob->coords.x : target.x) + MOB_PATH_MARGIN;
+    int bottom = (mob->coords.y > target.y ? mob->coords.y : target.y) + MOB_PATH_MARGIN;
+    left = left < 0 ? 0 : left;
+    top = top < 0 ? 0 : top;
+    right = right >= (int) map->width ? (int) map->width - 1 : right;
+    bottom = bottom >= (int) map->height ? (int) map->height - 1 : bottom;
+
+    if (mob->path && (left < mob->path->origin.x || top < mob->path->origin.y ||
+                right >= mob->path->origin.x + mob->path->width ||
+                bottom >= mob->path->origin.y + mob->path->height))
+        release_mob_path(mob);
+
+    if (mob->path == NULL)
+    {
+        mob->path = malloc(sizeof(MobPath));
+        assert(mob->path);
+        atomic_init(&mob->path->refs, 1);
+        mob->path->origin = RL_XY(left, top);
+        mob->path->width = right - left + 1;
+        mob->path->height = bottom - top + 1;
+        if (mob->path->width == map->width && mob->path->height == map->height)
+            mob->path->graph = rl_graph_create(map, rl_map_is_passable, false);
+        else
+        {
+            RL_Map *window = rl_map_create(mob->path->width, mob->path->height);
+            assert(window);
+            for (unsigned int y = 0; y < window->height; ++y)
+                for (unsigned int x = 0; x < window->width; ++x)
+                    *rl_map_tile(window, x, y) = *rl_map_tile(map, left + x, top + y);
+            mob->path->graph = rl_graph_create(window, rl_map_is_passable, false);
+            rl_map_destroy(window);
+        }
+        assert(mob->path->graph);
+
+        // index the nodes, so finding the one a mob is on doesn't search
+        const RL_Graph *graph = mob->path->graph;
+        size_t area = mob->path->width * mob->path->height;
+        mob->path->nodes = malloc(area * sizeof(int));
+        assert(mob->path->nodes);
+        memset(mob->path->nodes, -1, area * sizeof(int));
+        for (size_t i = 0; i < graph->length; ++i)
+            mob->path->nodes[(int) graph->nodes[i].point.y * mob->path->width + (int) graph->nodes[i].point.x] = i;
     }
 
-    // OOM check
-    if (m == NULL)
+    RL_Point origin = mob->path->origin;
+    mob->path->target = target;
+    rl_dijkstra_score(mob->path->graph, RL_XY(target.x - origin.x, target.y - origin.y), rl_distance_manhattan);
+}
+
+RL_GraphNode *mob_path_node(const MobPath *path, RL_Point coords)
+{
+    int x = coords.x - path->origin.x, y = coords.y - path->origin.y;
+    if (x < 0 || y < 0 || x >= (int) path->width || y >= (int) path->height || path->nodes[y * path->width + x] < 0)
         return NULL;
 
-    if (m->form & MOB_FORM_BIPED)
+    return &path->graph->nodes[path->nodes[y * path->width + x]];
+}
+
+void release_mob_path(Mob *mob)
+{
+    if (mob->path == NULL)
+        return;
+
+    if (atomic_fetch_sub(&mob->path->refs, 1) == 1)
     {
-        // give mob some gold
-        give_mob_item(m, create_item(depth, ITEM_GOLD));
+        rl_graph_destroy(mob->path->graph);
+        free(mob->path->nodes);
+        free(mob->path);
+    }
+    mob->path = NULL;
+}
 
-        // give mob default weapon
-        if (m->equipment.weapon == NULL)
-        {
-            // difficulty * 10 percent chance of weapon
-            if (generate(1, 100) <= difficulty*10)
-            {
-                Item *item = create_item(depth, ITEM_WEAPON);
+// create random item & give it to mob
+// returns the item, or NULL on OOM or full inventory (don't use stackable
+// items, they may have been merged into an existing stack)
+Item *give_loot(Game *game, Mob *m, int depth, int type)
+{
+    Item *item = create_item(game, depth, type);
 
-                // OOM check
-                if (m == NULL)
-                    return NULL;
+    // OOM check
+    if (item == NULL)
+        return NULL;
 
-                if (give_mob_item(m, item))
-                    m->equipment.weapon = item;
-            }
-        }
+    if (!give_mob_item(game, m, item))
+    {
+        free(item);
 
-        // give mob default armor
-        if (m->equipment.armor == NULL)
-        {
-            // difficulty * 5 percent chance of armor
-            if (generate(1, 100) <= difficulty*5)
-            {
-                Item *item = create_item(depth, ITEM_ARMOR);
+        return NULL;
+    }
 
-                // OOM check
-                if (m == NULL)
-                    return NULL;
+    return item;
+}
 
-                if (give_mob_item(m, item))
-                    m->equipment.armor = item;
-            }
-        }
+Equipment mob_equipment(Game *game, Mob *mob)
+{
+    // give mob default weapon
+    if (mob->loot.kit & LOOT_WEAPON) {
+        Item *weapon = give_loot(game, mob, mob->loot.depth, ITEM_WEAPON);
+        if (weapon)
+            mob->inventory->equipment.weapon = weapon;
+    }
 
-        // give mob potion or scroll
-        if (generate(1, 100) <= difficulty*5) {
-            Item *item = create_item(depth, ITEM_POTION);
+    // give mob default armor
+    if (mob->loot.kit & LOOT_ARMOR) {
+        Item *armor = give_loot(game, mob, mob->loot.depth, ITEM_ARMOR);
+        if (armor)
+            mob->inventory->equipment.armor = armor;
+    }
 
-            // OOM check
-            if (m == NULL)
-                return NULL;
+    mob->loot.kit &= ~(LOOT_WEAPON | LOOT_ARMOR);
 
-            give_mob_item(m, item);
-        } else if (generate(1, 100) <= difficulty*5) {
-            Item *item = create_item(depth, ITEM_SCROLL);
+    if (mob->inventory == NULL)
+        return (Equipment) {0};
 
-            // OOM check
-            if (m == NULL)
-                return NULL;
+    return mob->inventory->equipment;
+}
 
-            give_mob_item(m, item);
-        }
-    }
+void materialize_loot(Game *game, Mob *mob)
+{
+    mob_equipment(game, mob);
 
-    m->difficulty = difficulty;
-    m->coords = coords;
-    m->dijkstra_graph = NULL;
+    // give mob some gold
+    if (mob->loot.kit & LOOT_GOLD)
+        give_loot(game, mob, mob->loot.depth, ITEM_GOLD);
 
-    return m;
+    // give mob potion or scroll
+    if (mob->loot.kit & LOOT_POTION)
+        give_loot(game, mob, mob->loot.depth, ITEM_POTION);
+    else if (mob->loot.kit & LOOT_SCROLL)
+        give_loot(game, mob, mob->loot.depth, ITEM_SCROLL);
+
+    mob->loot.kit = 0;
 }
 
 // try to attack x, y
 // if no mob found at x, y do nothing
-int attack(Mob *attacker, Mob *target, Item *weapon)
+int attack(Game *game, Mob *attacker, Mob *target, Item *weapon)
 {
     if (attacker == NULL || target == NULL)
         return 0;
 
     int damage = 0;
     if (weapon != NULL)
-        damage = generate(weapon->damage.min, weapon->damage.max);
+        damage = generate(&game->random.streams[RNG_COMBAT], weapon->damage.min, weapon->damage.max);
     else
-        damage = generate(attacker->minDamage, attacker->maxDamage);
+        damage = generate(&game->random.streams[RNG_COMBAT], attacker->minDamage, attacker->maxDamage);
 
     // calculate DR based on equipped armor
-    if (target->equipment.armor != NULL)
+    Item *armor = mob_equipment(game, target).armor;
+    if (armor != NULL)
     {
-        damage -= target->equipment.armor->armor.damageReduction;
+        damage -= armor->armor.damageReduction;
         // always hit for a minimum of 1 damage
         if (damage <= 0) damage = 1;
     }
 
+    hash_mob(game, target);
     target->hp -= damage;
+    hash_mob(game, target);
 
     return damage;
 }
 
-Mob *enemy(int hp, int minDamage, int maxDamage, char symbol, int form)
+Mob enemy(int hp, int minDamage, int maxDamage, char symbol, int form)
 {
-    Mob *m;
-    m = malloc(sizeof(Mob));
-
-    m->hp = hp;
-    m->maxHP = hp;
-    m->minDamage = minDamage;
-    m->maxDamage = maxDamage;
-    m->symbol = symbol;
-    m->type = MOB_ENEMY;
-    m->form = form;
-    m->itemCount = 0;
-    m->equipment = (Equipment) {0};
-    memset(m->items, 0, MAX_INVENTORY_ITEMS*sizeof(Item*));
+    Mob m = {0};
+
+    m.hp = hp;
+    m.maxHP = hp;
+    m.minDamage = minDamage;
+    m.maxDamage = maxDamage;
+    m.symbol = symbol;
+    m.type = MOB_ENEMY;
+    m.form = form;
 
     return m;
 }
 
-int insert_mob(Mob *mob, Mob **mobs)
+Mob *insert_mob(Game *game, Mob mob, Mob *mobs, int *mobCount)
 {
-    // seek to available mob index
-    int mobIndex = 0;
-    while (mobs[mobIndex] != NULL)
-    {
-        ++mobIndex;
-        if (mobIndex >= MAX_MOBS)
-            return 0; // out of range!
-    }
+    if (*mobCount >= MAX_MOBS)
+        return NULL; // out of range!
 
-    mobs[mobIndex] = mob;
+    mobs[*mobCount] = mob;
+    hash_mob(game, &mob);
 
-    return 1;
+    return &mobs[(*mobCount)++];
+}
+
+void remove_mob(int index, Mob *mobs, int *mobCount)
+{
+    // keep list packed by moving last mob into the hole
+    --(*mobCount);
+    if (index != *mobCount)
+        mobs[index] = mobs[*mobCount];
+    mobs[*mobCount] = (Mob) {0};
 }
 
 /* int kill_mob(Mob *mob, Mobs *mobs) */
@@ -248,62 +362,108 @@ const char* mob_name(char symbol)
     }
 }
 
-int give_mob_item(Mob *mob, Item *item)
+// grow mob inventory to fit one more item
+// returns 0 if inventory is full or on OOM
+int reserve_mob_item(Mob *mob)
+{
+    Inventory *inventory = mob->inventory;
+    if (inventory && inventory->itemCount < inventory->capacity)
+        return 1;
+
+    int capacity = SMALL_INVENTORY_ITEMS;
+    if (inventory) {
+        if (inventory->capacity >= MAX_INVENTORY_ITEMS)
+            return 0;
+        capacity = inventory->capacity * 2;
+        if (capacity > MAX_INVENTORY_ITEMS)
+            capacity = MAX_INVENTORY_ITEMS;
+    }
+
+    inventory = realloc(inventory, sizeof(Inventory) + capacity*sizeof(Item*));
+    if (inventory == NULL)
+        return 0;
+
+    if (mob->inventory == NULL) {
+        inventory->itemCount = 0;
+        inventory->equipment = (Equipment) {0};
+    }
+    inventory->capacity = capacity;
+    mob->inventory = inventory;
+
+    return 1;
+}
+
+int give_mob_item(Game *game, Mob *mob, Item *item)
 {
-    if (is_stackable(*item)) {
+    Inventory *inventory = mob->inventory;
+
+    if (inventory && is_stackable(*item)) {
         // append amount to existing item(s)
-        for (int i = 0; i < mob->itemCount; ++i) {
-            if (mob->items[i]->name == item->name) {
-                mob->items[i]->amount += item->amount;
-                // TODO need to free item!
+        for (int i = 0; i < inventory->itemCount; ++i) {
+            if (inventory->items[i]->name == item->name) {
+                hash_inventory_item(game, inventory->items[i]);
+                inventory->items[i]->amount += item->amount;
+                hash_inventory_item(game, inventory->items[i]);
+                free(item);
 
                 return 1;
             }
         }
     }
 
-    if (mob->itemCount >= MAX_INVENTORY_ITEMS) return 0;
+    if (!reserve_mob_item(mob)) return 0;
 
-    mob->items[(mob->itemCount)++] = item;
+    inventory = mob->inventory;
+    inventory->items[(inventory->itemCount)++] = item;
+    hash_inventory_item(game, item);
 
     return 1;
 }
 
 // shift everything left after item & remove it from inventory
-void shift_mob_item(Mob *mob, int i)
+void shift_mob_item(Game *game, Mob *mob, int i)
 {
-    Item *item = mob->items[i];
-    mob->items[i] = NULL;
+    Inventory *inventory = mob->inventory;
+    Equipment *equipment = &inventory->equipment;
+    Item *item = inventory->items[i];
+    inventory->items[i] = NULL;
+    hash_inventory_item(game, item);
 
     // reset equipped & readied if set
-    if (mob->equipment.readied && mob->equipment.readied->id == item->id)
-        mob->equipment.readied = NULL;
-    if (mob->equipment.weapon && mob->equipment.weapon->id == item->id)
-        mob->equipment.weapon = NULL;
-    if (mob->equipment.armor && mob->equipment.armor->id == item->id)
-        mob->equipment.armor = NULL;
-
-    for (int j = i + 1; j < mob->itemCount; ++j) {
-        mob->items[i] = mob->items[j];
+    if (equipment->readied && equipment->readied->id == item->id)
+        equipment->readied = NULL;
+    if (equipment->weapon && equipment->weapon->id == item->id)
+        equipment->weapon = NULL;
+    if (equipment->armor && equipment->armor->id == item->id)
+        equipment->armor = NULL;
+
+    for (int j = i + 1; j < inventory->itemCount; ++j) {
+        inventory->items[i] = inventory->items[j];
         i++;
     }
-    mob->itemCount--;
+    inventory->itemCount--;
 }
 
-int decrement_mob_item(Mob *mob, Item *item)
+int decrement_mob_item(Game *game, Mob *mob, Item *item)
 {
     if (!is_stackable(*item)) {
-        return remove_mob_item(mob, item);
+        return remove_mob_item(game, mob, item);
     }
 
+    Inventory *inventory = mob->inventory;
+    if (inventory == NULL)
+        return 0;
+
     // decrement amount of existing item(s)
-    for (int i = 0; i < mob->itemCount; ++i) {
-        if (mob->items[i]->name == item->name) {
-            mob->items[i]->amount -= 1;
+    for (int i = 0; i < inventory->itemCount; ++i) {
+        if (inventory->items[i]->name == item->name) {
+            hash_inventory_item(game, inventory->items[i]);
+            inventory->items[i]->amount -= 1;
+            hash_inventory_item(game, inventory->items[i]);
 
             // remove item if amount 0
-            if (mob->items[i]->amount == 0) {
-                shift_mob_item(mob, i);
+            if (inventory->items[i]->amount == 0) {
+                shift_mob_item(game, mob, i);
 
                 return 1;
             }
@@ -315,11 +475,15 @@ int decrement_mob_item(Mob *mob, Item *item)
     return 0;
 }
 
-int remove_mob_item(Mob *mob, Item *item)
+int remove_mob_item(Game *game, Mob *mob, Item *item)
 {
-    for (int i = 0; i < mob->itemCount; ++i) {
-        if (mob->items[i] == item) {
-            shift_mob_item(mob, i);
+    Inventory *inventory = mob->inventory;
+    if (inventory == NULL)
+        return 0;
+
+    for (int i = 0; i < inventory->itemCount; ++i) {
+        if (inventory->items[i] == item) {
+            shift_mob_item(game, mob, i);
 
             return 1;
         }
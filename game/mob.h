@@ -4,6 +4,7 @@
 #define MAX_MOBS            10
 #define MAX_PLAYER_LEVEL    20
 #define MAX_INVENTORY_ITEMS 27 // 1 spot for gold + 26 inventory letters
+#define SMALL_INVENTORY_ITEMS 4 // initial inventory size, most enemies never grow it
 
 #define MOB_PLAYER 1
 #define MOB_ENEMY  2
@@ -11,12 +12,17 @@
 #define MOB_MIND_FLAYER 4
 #define MOB_DEMON 5
 
+#define MOB_SYMBOLS 128 // mob symbols are ascii, used to index per-species stats
+#define MOB_PATH_MARGIN 80 // tiles around mob & target a path may go through
+
 #define MOB_FORM_BIPED 1
 #define MOB_FORM_QUADRAPED 2
 #define MOB_FORM_FLYING 4
 
 #include "item.h"
+#include "random.h"
 #include "lib/roguelike.h"
+#include <stdatomic.h>
 
 typedef struct {
     int exp;
@@ -30,46 +36,100 @@ typedef struct {
     Item *readied; // readied item to throw/fire
 } Equipment;
 
+// loot carried by a mob which hasn't been created yet
+typedef struct {
+    unsigned char depth; // dungeon depth to generate items for
+    unsigned char kit;   // LOOT flags of items still to create
+} Loot;
+
+// cold mob data, only touched when items change hands
+typedef struct {
+    int itemCount;
+    int capacity; // grows up to MAX_INVENTORY_ITEMS
+    Equipment equipment;
+    Item *items[];
+} Inventory;
+
+// dijkstra map a mob is walking, shared with clones until one rescores it
+typedef struct {
+    atomic_int refs;
+    RL_Graph *graph; // points are relative to origin
+    RL_Point origin; // part of the map the graph covers
+    unsigned int width, height;
+    int *nodes; // graph node of each tile of that part, -1 if impassable
+    RL_Point target; // what the graph was last scored towards
+} MobPath;
+
+// hot mob data, kept packed in the level mobs array
 typedef struct {
-    int hp, maxHP;
     RL_Point coords;
+    int depth; // of the level the mob is on
+    int hp, maxHP;
+    char symbol;
+    Loot loot;
     int minDamage, maxDamage;
     int type;
     int form;
-    char symbol;
-    Item *items[MAX_INVENTORY_ITEMS];
-    RL_Graph *dijkstra_graph;
-    int itemCount;
-    Equipment equipment;
     union {
         PlayerAttributes attrs;
         int difficulty; // TODO use this for exp
     };
+    MobPath *path; // NULL if mob isn't walking anywhere
+    RNG rng; // AI stream
+    Inventory *inventory; // NULL until mob is given an item
 } Mob;
 
-// return a random mob for the specified dungeon depth
-Mob *create_mob(int depth, RL_Point coords);
+// return a random mob for the specified dungeon depth, rolled from rng
+// (its own stream is split from the seed of game)
+Mob create_mob(Game *game, int depth, RL_Point coords, RNG *rng);
+
+// free mob inventory & path (items are left alone)
+void destroy_mob(Mob *mob);
+
+// copy mob with a copy of each item it carries, path is shared
+// returns 0 on OOM
+int clone_mob(Mob *clone, const Mob *mob);
+
+// score mob path towards target, the graph is created first if the mob
+// has none, shares it with a clone or it doesn't cover mob & target
+void score_mob_path(Mob *mob, RL_Map *map, RL_Point target);
+
+// node of path at map coords, NULL if the graph doesn't have one
+RL_GraphNode *mob_path_node(const MobPath *path, RL_Point coords);
+
+// stop walking current path
+void release_mob_path(Mob *mob);
+
+// return mob equipment, creating pending weapon & armor loot first
+Equipment mob_equipment(Game *game, Mob *mob);
+
+// create all pending loot in mob inventory (i.e. before dropping it)
+void materialize_loot(Game *game, Mob *mob);
 
 // try to attack x, y
 // if no mob found at x, y do nothing
 // return damage
-int attack(Mob *attacker, Mob *target, Item *weapon);
+int attack(Game *game, Mob *attacker, Mob *target, Item *weapon);
+
+// insert mob at the end of packed mobs list
+// returns inserted mob, or NULL if mobs list is full
+Mob *insert_mob(Game *game, Mob mob, Mob *mobs, int *mobCount);
 
-// insert mob into mobs list
-int insert_mob(Mob *mob, Mob **mobs);
+// remove mob from packed mobs list (last mob is moved into its place)
+void remove_mob(int index, Mob *mobs, int *mobCount);
 
 // return mob name for symbol
 const char* mob_name(char symbol);
 
-// give item to mob
-int give_mob_item(Mob *mob, Item *item);
+// give item to mob, item is freed if it was added to an existing stack
+int give_mob_item(Game *game, Mob *mob, Item *item);
 
 // decrement item from mob (this decrements quantity by 1 if >1)
 // returns 1 if item has been removed from mob inventory,
 // or -1 if amount of item in inventory decremented (0 on error)
-int decrement_mob_item(Mob *mob, Item *item);
+int decrement_mob_item(Game *game, Mob *mob, Item *item);
 
 // remove item from mob entirely
-int remove_mob_item(Mob *mob, Item *item);
+int remove_mob_item(Game *game, Mob *mob, Item *item);
 
 #endif
@@ -1,15 +1,98 @@
 #include "random.h"
-#include "lib/roguelike.h"
 
-#include <stdlib.h>
-#include <time.h>
+// splitmix64, used to turn seeds & names into stream parameters
+uint64_t random_mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return x ^ (x >> 31);
+}
+
+// seed a PCG32 stream (inc must be odd)
+RNG seed_stream(uint64_t seed, uint64_t sequence)
+{
+    RNG rng = { 0, (sequence << 1) | 1 };
+    next_random(&rng);
+    rng.state += seed;
+    next_random(&rng);
+
+    return rng;
+}
+
+void init_random(RandomState *random, uint64_t seed)
+{
+    random->seed = seed;
+    for (int name = 0; name < RNG_GLOBAL_STREAMS; ++name)
+        random->streams[name] = split_stream(seed, name, 0);
+}
+
+RNG split_stream(uint64_t seed, int name, uint64_t index)
+{
+    uint64_t key = random_mix(seed ^ random_mix(((uint64_t) name << 56) ^ index));
+
+    return seed_stream(key, random_mix(key));
+}
 
-void init_random(unsigned int seed)
+uint32_t next_random(RNG *rng)
 {
-    srand(seed);
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+
+    uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+    uint32_t rot = old >> 59;
+
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
 }
 
-int generate(int min, int max)
+int generate(RNG *rng, int min, int max)
 {
-    return rl_rng_generate(min, max);
+    if (max <= min)
+        return min;
+    if ((uint32_t) max - (uint32_t) min == UINT32_MAX)
+        return (int) next_random(rng);
+
+    // Lemire's multiply & reject, unbiased without a division per roll
+    uint32_t range = (uint32_t) max - (uint32_t) min + 1;
+    uint64_t m = (uint64_t) next_random(rng) * range;
+    if ((uint32_t) m < range)
+    {
+        uint32_t threshold = -range % range;
+        while ((uint32_t) m < threshold)
+            m = (uint64_t) next_random(rng) * range;
+    }
+
+    return min + (int) (m >> 32);
+}
+
+void generate_many(RNG *rng, int min, int max, int *values, int count)
+{
+    if (max <= min)
+    {
+        for (int i = 0; i < count; ++i)
+            values[i] = min;
+
+        return;
+    }
+
+    if ((uint32_t) max - (uint32_t) min == UINT32_MAX)
+    {
+        for (int i = 0; i < count; ++i)
+            values[i] = (int) next_random(rng);
+
+        return;
+    }
+
+    uint32_t range = (uint32_t) max - (uint32_t) min + 1;
+    uint32_t threshold = -range % range; // computed once for the batch
+    for (int i = 0; i < count; ++i)
+    {
+        uint64_t m;
+        do
+            m = (uint64_t) next_random(rng) * range;
+        while ((uint32_t) m < threshold);
+
+        values[i] = min + (int) (m >> 32);
+    }
 }
@@ -1,13 +1,43 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
-// allocate our (P)RNG memory
-void init_random();
+#include <stdint.h>
 
-// seed our (P)RNG
-void seed_random();
+// stream names
+#define RNG_COMBAT 0 // attack & item effect rolls (per game)
+#define RNG_LOOT   1 // item creation (per game)
+#define RNG_LEVEL  2 // map generation, stairs & spawns, split per level
+#define RNG_MOB    3 // AI wandering, split per mob from its level stream
+#define RNG_BOT    4 // scripted player (see bot.h), never rolled by the game itself
+
+#define RNG_GLOBAL_STREAMS 2 // number of per game streams
+
+// PCG32 generator, each inc selects an independent stream
+typedef struct {
+    uint64_t state;
+    uint64_t inc;
+} RNG;
+
+// seed & per game streams, kept in the game context (see context.h)
+typedef struct {
+    uint64_t seed;
+    RNG streams[RNG_GLOBAL_STREAMS];
+} RandomState;
+
+// seed the per game streams of random, split streams are derived from
+// seed too
+void init_random(RandomState *random, uint64_t seed);
+
+// derive an independent stream from seed, i.e. (RNG_LEVEL, depth)
+RNG split_stream(uint64_t seed, int name, uint64_t index);
+
+// next raw 32 bits of stream
+uint32_t next_random(RNG *rng);
 
 // generate value >= min and <= max
-int generate(int min, int max);
+int generate(RNG *rng, int min, int max);
+
+// fill values with count rolls >= min and <= max
+void generate_many(RNG *rng, int min, int max, int *values, int count);
 
 #endif
@@ -0,0 +1,506 @@
+#include "recording.h"
+#include "game.h"
+#include "context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Recording layout (native byte order):
+//
+//   RecordingHeader
+//   frames, each a RecordingFrame followed by its body
+//   RecordingIndex of every keyframe
+//   RecordingFooter
+//
+// A frame body is a list of runs over the screen cells in reading order,
+// then the status area as uint16 length & text (RECORDING_SAME_TEXT if it
+// didn't change). Runs are an op byte & uint16 count followed by nothing for
+// RECORDING_SKIP (cells unchanged since the previous frame), one cell for
+// RECORDING_FILL & count cells for RECORDING_COPY. Cells are uint16 symbol &
+// uint8 style (color pair, RECORDING_BOLD). Keyframes have no skips. The
+// index is only written when the recording is closed, without it the
+// frames are scanned for keyframes instead.
+
+#define RECORDING_MAGIC       "SRLR"
+#define RECORDING_INDEX_MAGIC "SRLI"
+
+#define RECORDING_SKIP 0
+#define RECORDING_FILL 1
+#define RECORDING_COPY 2
+
+#define RECORDING_BOLD      0x80
+#define RECORDING_SAME_TEXT UINT16_MAX
+
+#define RECORDING_CELLS     (MAX_HEIGHT * MAX_WIDTH)
+#define RECORDING_CELL_SIZE 3
+#define RECORDING_RUN_SIZE  3
+#define RECORDING_BODY_SIZE (RECORDING_CELLS * (RECORDING_CELL_SIZE + RECORDING_RUN_SIZE) + 2 + RECORDING_TEXT_SIZE)
+
+typedef unsigned char RecordingCell[RECORDING_CELL_SIZE];
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t seed;
+} RecordingHeader;
+
+typedef struct {
+    uint8_t keyframe;
+    uint8_t unused[3];
+    int32_t turn;
+    uint32_t size; // of the body
+} RecordingFrame;
+
+typedef struct {
+    char magic[4];
+    uint32_t count; // index entries
+    uint64_t offset; // of the index
+    int32_t lastTurn;
+    uint32_t unused;
+} RecordingFooter;
+
+struct Recording_t {
+    FILE *file;
+    uint64_t offset; // of the next frame
+    uint32_t frames;
+    int32_t lastTurn;
+
+    RecordingIndex *index;
+    int indexCount, indexCapacity;
+
+    // last recorded frame
+    RecordingCell cells[RECORDING_CELLS];
+    char text[RECORDING_TEXT_SIZE];
+
+    unsigned char body[RECORDING_BODY_SIZE]; // of the frame being written
+    char buffer[RECORDING_BUFFER_SIZE];
+};
+
+void encode_cell(unsigned char *cell, const DrawTile *tile);
+void status_text(const Game *game, const Dungeon *dungeon, char *text);
+size_t encode_runs(unsigned char *body, RecordingCell *cells, RecordingCell *prev);
+size_t decode_frame(Playback *playback, size_t offset);
+int add_recording_index(RecordingIndex **index, int *count, int *capacity, RecordingIndex entry);
+
+Recording *open_recording(const char *filename, unsigned long seed)
+{
+    Recording *recording = calloc(1, sizeof(Recording));
+    if (recording == NULL)
+        return NULL;
+
+    recording->file = fopen(filename, "wb");
+    if (recording->file == NULL)
+    {
+        free(recording);
+
+        return NULL;
+    }
+    setvbuf(recording->file, recording->buffer, _IOFBF, RECORDING_BUFFER_SIZE);
+
+    RecordingHeader header = {0};
+    memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+    header.version = RECORDING_VERSION;
+    header.seed = seed;
+    fwrite(&header, sizeof(header), 1, recording->file);
+    recording->offset = sizeof(header);
+
+    return recording;
+}
+
+void record_frame(Recording *recording, const Game *game, const Dungeon *dungeon)
+{
+    if (recording == NULL)
+        return;
+
+    RecordingCell cells[RECORDING_CELLS];
+    for (int y = 0; y < MAX_HEIGHT; ++y)
+        for (int x = 0; x < MAX_WIDTH; ++x)
+            encode_cell(cells[y * MAX_WIDTH + x], &game->drawBuffer[y][x]);
+
+    char text[RECORDING_TEXT_SIZE];
+    status_text(game, dungeon, text);
+
+    // nothing to see, i.e. while resting out of sight
+    int sameCells = memcmp(cells, recording->cells, sizeof(cells)) == 0;
+    int sameText = strcmp(text, recording->text) == 0;
+    if (recording->frames > 0 && sameCells && sameText)
+        return;
+
+    RecordingFrame frame = {0};
+    frame.keyframe = recording->frames % RECORDING_KEYFRAMES == 0;
+    frame.turn = dungeon->turn;
+
+    size_t size = encode_runs(recording->body, cells, frame.keyframe ? NULL : recording->cells);
+    uint16_t length = frame.keyframe || !sameText ? strlen(text) : RECORDING_SAME_TEXT;
+    memcpy(recording->body + size, &length, sizeof(length));
+    size += sizeof(length);
+    if (length != RECORDING_SAME_TEXT)
+    {
+        memcpy(recording->body + size, text, length);
+        size += length;
+    }
+    frame.size = size;
+
+    if (frame.keyframe)
+    {
+        RecordingIndex entry = { recording->offset, frame.turn, recording->frames };
+        add_recording_index(&recording->index, &recording->indexCount, &recording->indexCapacity, entry);
+    }
+
+    fwrite(&frame, sizeof(frame), 1, recording->file);
+    fwrite(recording->body, size, 1, recording->file);
+    recording->offset += sizeof(frame) + size;
+    ++recording->frames;
+    recording->lastTurn = frame.turn;
+    memcpy(recording->cells, cells, sizeof(cells));
+    strcpy(recording->text, text);
+}
+
+void close_recording(Recording *recording)
+{
+    if (recording == NULL)
+        return;
+
+    RecordingFooter footer = {0};
+    memcpy(footer.magic, RECORDING_INDEX_MAGIC, sizeof(footer.magic));
+    footer.count = recording->indexCount;
+    footer.offset = recording->offset;
+    footer.lastTurn = recording->lastTurn;
+    fwrite(recording->index, sizeof(RecordingIndex), recording->indexCount, recording->file);
+    fwrite(&footer, sizeof(footer), 1, recording->file);
+
+    fclose(recording->file);
+    free(recording->index);
+    free(recording);
+}
+
+Playback *open_playback(const char *filename)
+{
+    Playback *playback = calloc(1, sizeof(Playback));
+    if (playback == NULL)
+        return NULL;
+
+    // read whole file into memory
+    FILE *file = fopen(filename, "rb");
+    long size = -1;
+    if (file && fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        playback->data = malloc(size ? size : 1);
+        if (playback->data && fread(playback->data, 1, size, file) == (size_t) size)
+            playback->length = size;
+    }
+    if (file)
+        fclose(file);
+
+    RecordingHeader header;
+    if (playback->length < sizeof(header))
+    {
+        close_playback(playback);
+
+        return NULL;
+    }
+    memcpy(&header, playback->data, sizeof(header));
+    if (memcmp(header.magic, RECORDING_MAGIC, sizeof(header.magic)) != 0 || header.version != RECORDING_VERSION)
+    {
+        close_playback(playback);
+
+        return NULL;
+    }
+
+    // use the index if the recording was closed, otherwise find the
+    // keyframes (i.e. after a crash)
+    RecordingFooter footer;
+    int indexed = 0;
+    if (playback->length >= sizeof(header) + sizeof(footer))
+    {
+        memcpy(&footer, playback->data + playback->length - sizeof(footer), sizeof(footer));
+        indexed = memcmp(footer.magic, RECORDING_INDEX_MAGIC, sizeof(footer.magic)) == 0 &&
+            footer.offset >= sizeof(header) &&
+            footer.offset + (uint64_t) footer.count * sizeof(RecordingIndex) + sizeof(footer) == playback->length;
+    }
+    if (indexed)
+    {
+        playback->end = footer.offset;
+        playback->lastTurn = footer.lastTurn;
+        playback->indexCount = footer.count;
+        playback->index = malloc((footer.count ? footer.count : 1) * sizeof(RecordingIndex));
+        if (playback->index)
+            memcpy(playback->index, playback->data + footer.offset, footer.count * sizeof(RecordingIndex));
+    }
+    else
+    {
+        int capacity = 0;
+        uint32_t frames = 0;
+        size_t offset = sizeof(header);
+        RecordingFrame frame;
+        playback->end = playback->length;
+        while (offset + sizeof(frame) <= playback->length)
+        {
+            memcpy(&frame, playback->data + offset, sizeof(frame));
+            if (frame.size > playback->length - offset - sizeof(frame))
+                break;
+
+            RecordingIndex entry = { offset, frame.turn, frames++ };
+            if (frame.keyframe && !add_recording_index(&playback->index, &playback->indexCount, &capacity, entry))
+                break;
+            playback->lastTurn = frame.turn;
+            offset += sizeof(frame) + frame.size;
+        }
+        playback->end = offset;
+    }
+
+    if (playback->index == NULL || playback->indexCount == 0 || !seek_playback(playback, playback->index[0].turn))
+    {
+        close_playback(playback);
+
+        return NULL;
+    }
+
+    return playback;
+}
+
+int seek_playback(Playback *playback, int turn)
+{
+    // last keyframe at or before turn
+    int low = 0, high = playback->indexCount - 1;
+    while (low < high)
+    {
+        int middle = (low + high + 1) / 2;
+        if (playback->index[middle].turn <= turn)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+
+    size_t next = decode_frame(playback, playback->index[low].offset);
+    if (next == 0)
+        return 0;
+    playback->offset = next;
+
+    while (next_playback_turn(playback) != -1 && next_playback_turn(playback) <= turn)
+        if (!next_playback_frame(playback))
+            return 0;
+
+    return 1;
+}
+
+int next_playback_turn(const Playback *playback)
+{
+    RecordingFrame frame;
+    if (playback->offset + sizeof(frame) > playback->end)
+        return -1;
+
+    memcpy(&frame, playback->data + playback->offset, sizeof(frame));
+
+    return frame.turn;
+}
+
+int next_playback_frame(Playback *playback)
+{
+    if (playback->offset >= playback->end)
+        return 0;
+
+    size_t next = decode_frame(playback, playback->offset);
+    if (next == 0)
+        return 0;
+    playback->offset = next;
+
+    return 1;
+}
+
+void close_playback(Playback *playback)
+{
+    if (playback == NULL)
+        return;
+
+    free(playback->index);
+    free(playback->data);
+    free(playback);
+}
+
+/*************/
+/**         **/
+/** private **/
+/**         **/
+/*************/
+
+void encode_cell(unsigned char *cell, const DrawTile *tile)
+{
+    uint16_t symbol = tile->symbol;
+    memcpy(cell, &symbol, sizeof(symbol));
+    cell[2] = (tile->colorPair & ~RECORDING_BOLD) | (tile->attr ? RECORDING_BOLD : 0);
+}
+
+void decode_cell(DrawTile *tile, const unsigned char *cell)
+{
+    uint16_t symbol;
+    memcpy(&symbol, cell, sizeof(symbol));
+    tile->symbol = symbol;
+    tile->colorPair = cell[2] & ~RECORDING_BOLD;
+    tile->attr = cell[2] & RECORDING_BOLD ? A_BOLD : 0;
+}
+
+// the status area as drawn by draw_status, a line per row
+void status_text(const Game *game, const Dungeon *dungeon, char *text)
+{
+    const Mob *player = dungeon->player;
+    char status[4][MAX_WIDTH / 2 + 1];
+    snprintf(status[0], sizeof(status[0]), "HP: %d / %d", player->hp, player->maxHP);
+    snprintf(status[1], sizeof(status[1]), "LVL: %d, EXP: %d", player->attrs.level, player->attrs.exp);
+    snprintf(status[2], sizeof(status[2]), "Depth: %d", dungeon->level->depth);
+    snprintf(status[3], sizeof(status[3]), "Gold: %d", total_gold(player->inventory->items, player->inventory->itemCount));
+
+    // messages start half way across the view, like in draw_status
+    int column = game->viewWidth / 2;
+    size_t length = 0;
+    for (int y = 0; y < MAX_MESSAGES; ++y)
+    {
+        const char *left = y < 4 ? status[y] : "";
+        const char *message = get_message(game, y);
+        if (message)
+            length += sprintf(text + length, "%-*.*s%.*s\n", column, column, left, MAX_WIDTH - column, message);
+        else
+            length += sprintf(text + length, "%s\n", left);
+    }
+    text[length] = '\0';
+}
+
+int same_cell(const unsigned char *a, const unsigned char *b)
+{
+    return memcmp(a, b, RECORDING_CELL_SIZE) == 0;
+}
+
+size_t write_run(unsigned char *body, int op, int count)
+{
+    uint16_t length = count;
+    body[0] = op;
+    memcpy(body + 1, &length, sizeof(length));
+
+    return RECORDING_RUN_SIZE;
+}
+
+// encode cells as runs, only the ones changed since prev unless it's NULL
+// returns size of the runs
+size_t encode_runs(unsigned char *body, RecordingCell *cells, RecordingCell *prev)
+{
+    size_t size = 0;
+    int i = 0;
+    while (i < RECORDING_CELLS)
+    {
+        int count = 0;
+        if (prev)
+            while (i + count < RECORDING_CELLS && same_cell(cells[i + count], prev[i + count]))
+                ++count;
+        if (count)
+        {
+            size += write_run(body + size, RECORDING_SKIP, count);
+            i += count;
+            continue;
+        }
+
+        // the same cell over & over, mostly blanks & walls
+        while (i + count < RECORDING_CELLS && same_cell(cells[i + count], cells[i]))
+            ++count;
+        if (count >= 3)
+        {
+            size += write_run(body + size, RECORDING_FILL, count);
+            memcpy(body + size, cells[i], RECORDING_CELL_SIZE);
+            size += RECORDING_CELL_SIZE;
+            i += count;
+            continue;
+        }
+
+        // changed cells up to the next unchanged cell or fill
+        count = 1;
+        while (i + count < RECORDING_CELLS &&
+                !(prev && same_cell(cells[i + count], prev[i + count])) &&
+                !(i + count + 2 < RECORDING_CELLS &&
+                    same_cell(cells[i + count], cells[i + count + 1]) &&
+                    same_cell(cells[i + count], cells[i + count + 2])))
+            ++count;
+        size += write_run(body + size, RECORDING_COPY, count);
+        memcpy(body + size, cells[i], count * RECORDING_CELL_SIZE);
+        size += count * RECORDING_CELL_SIZE;
+        i += count;
+    }
+
+    return size;
+}
+
+// apply the frame at offset to the current frame of playback
+// returns offset of the next frame, 0 if the frame is broken
+size_t decode_frame(Playback *playback, size_t offset)
+{
+    RecordingFrame frame;
+    if (offset + sizeof(frame) > playback->end)
+        return 0;
+    memcpy(&frame, playback->data + offset, sizeof(frame));
+    if (frame.size > playback->end - offset - sizeof(frame))
+        return 0;
+
+    const unsigned char *body = playback->data + offset + sizeof(frame);
+    size_t size = 0;
+    int i = 0;
+    while (i < RECORDING_CELLS)
+    {
+        uint16_t count;
+        if (size + RECORDING_RUN_SIZE > frame.size)
+            return 0;
+        int op = body[size];
+        memcpy(&count, body + size + 1, sizeof(count));
+        size += RECORDING_RUN_SIZE;
+        if (count == 0 || count > RECORDING_CELLS - i)
+            return 0;
+
+        if (op == RECORDING_SKIP)
+            i += count;
+        else if (op == RECORDING_FILL && size + RECORDING_CELL_SIZE <= frame.size)
+        {
+            for (int end = i + count; i < end; ++i)
+                decode_cell(&playback->tiles[i / MAX_WIDTH][i % MAX_WIDTH], body + size);
+            size += RECORDING_CELL_SIZE;
+        }
+        else if (op == RECORDING_COPY && size + count * RECORDING_CELL_SIZE <= frame.size)
+        {
+            for (int end = i + count; i < end; ++i, size += RECORDING_CELL_SIZE)
+                decode_cell(&playback->tiles[i / MAX_WIDTH][i % MAX_WIDTH], body + size);
+        }
+        else
+            return 0;
+    }
+
+    uint16_t length;
+    if (size + sizeof(length) > frame.size)
+        return 0;
+    memcpy(&length, body + size, sizeof(length));
+    size += sizeof(length);
+    if (length != RECORDING_SAME_TEXT)
+    {
+        if (length >= RECORDING_TEXT_SIZE || size + length > frame.size)
+            return 0;
+        memcpy(playback->text, body + size, length);
+        playback->text[length] = '\0';
+    }
+
+    playback->turn = frame.turn;
+
+    return offset + sizeof(frame) + frame.size;
+}
+
+// returns 0 on OOM
+int add_recording_index(RecordingIndex **index, int *count, int *capacity, RecordingIndex entry)
+{
+    if (*count == *capacity)
+    {
+        int grown = *capacity ? *capacity * 2 : 64;
+        RecordingIndex *entries = realloc(*index, grown * sizeof(RecordingIndex));
+        if (entries == NULL)
+            return 0;
+
+        *index = entries;
+        *capacity = grown;
+    }
+    (*index)[(*count)++] = entry;
+
+    return 1;
+}
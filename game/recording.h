@@ -0,0 +1,73 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#define RECORDING_VERSION     1
+#define RECORDING_BUFFER_SIZE 65536 // bytes buffered before each write
+#define RECORDING_KEYFRAMES   100   // frames between keyframes
+#define RECORDING_TEXT_SIZE   ((MAX_WIDTH + 1) * MAX_MESSAGES + 1) // status area, a line per row
+
+#include "draw.h"
+#include "message.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// What the player saw during a game, frame by frame, to review it later.
+// Frames hold the DrawTile changes since the previous frame and the status
+// area; every RECORDING_KEYFRAMES frames is a keyframe with the full screen.
+// An index of keyframes at the end of the file makes any turn reachable by
+// decoding at most one keyframe interval.
+typedef struct Recording_t Recording;
+
+// index entry of a keyframe
+typedef struct {
+    uint64_t offset; // of the frame in the file
+    int32_t turn;
+    uint32_t frame; // number of the frame
+} RecordingIndex;
+
+// recording being played back
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t offset; // of the next frame
+    size_t end; // of the frames
+
+    RecordingIndex *index;
+    int indexCount;
+    int lastTurn;
+
+    // current frame
+    int turn;
+    DrawTile tiles[MAX_HEIGHT][MAX_WIDTH];
+    char text[RECORDING_TEXT_SIZE]; // status area, rows separated by newlines
+} Playback;
+
+// start recording a new game with seed
+// returns NULL on error
+Recording *open_recording(const char *filename, unsigned long seed);
+
+// record the frame last rendered into game (see render & render_frame),
+// frames that look the same as the previous one are skipped
+void record_frame(Recording *recording, const Game *game, const Dungeon *dungeon);
+
+// write the index & close the recording
+void close_recording(Recording *recording);
+
+// load recording for playback, positioned on its first frame
+// returns NULL if it can't be read
+Playback *open_playback(const char *filename);
+
+// show the last frame at or before turn
+// returns 0 if the recording is broken
+int seek_playback(Playback *playback, int turn);
+
+// turn of the next frame, -1 at the end of the recording
+int next_playback_turn(const Playback *playback);
+
+// show the next frame
+// returns 0 at the end of the recording
+int next_playback_frame(Playback *playback);
+
+void close_playback(Playback *playback);
+
+#endif
@@ -0,0 +1,1030 @@
+#include "save.h"
+#include "table.h"
+#include "hash.h"
+#include "context.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Snapshot layout (native byte order, every block 8 byte aligned):
+//
+//   SaveHeader
+//   SavedItem[player.itemCount]
+//   for each generated level, at header.levelOffset[depth - 1]:
+//     SavedLevel
+//     RL_Byte tiles[width*height]
+//     RL_Byte visibility[width*height]
+//     SavedMob[mobCount]
+//     SavedItem[itemCount]       (items of each mob, in mob order)
+//     SavedFloorItem[floorCount]
+//
+// Records only hold offsets & indexes, so the file can be mapped and
+// each level is turned back into game structs the first time it's used.
+// Packed levels (see pack_level) are the same level block run through
+// PackBits: a count byte n, then n + 1 literal bytes if n < 128, otherwise
+// the next byte repeated 257 - n times.
+
+#define SAVE_MAGIC "SRLS"
+#define SAVE_ALIGN 8
+
+typedef struct {
+    int32_t id;
+    int32_t kind; // see item_kind
+    int32_t type;
+    int32_t amount;
+    WeaponAttributes data; // item union (weapon attributes are the largest member)
+} SavedItem;
+
+typedef struct {
+    int32_t x, y;
+    SavedItem item;
+} SavedFloorItem;
+
+typedef struct {
+    int32_t x, y;
+    int32_t hp, maxHP;
+    int32_t minDamage, maxDamage;
+    int32_t type, form;
+    int32_t symbol;
+    int32_t lootDepth, lootKit;
+    PlayerAttributes attrs; // shares storage with difficulty
+    int32_t itemCount;
+    int32_t weapon, armor, readied; // index of equipped item or -1
+    int32_t pathX, pathY; // where the mob is walking, -1 if it isn't
+    RNG rng;
+} SavedMob;
+
+typedef struct {
+    int32_t depth;
+    uint32_t width, height;
+    int32_t upX, upY, downX, downY;
+    uint32_t mobCount;
+    uint32_t itemCount;
+    uint32_t floorCount;
+    int32_t leftTurn;
+    RNG rng;
+} SavedLevel;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t seed;
+    int32_t turn;
+    int32_t nextItemId;
+    int32_t depth; // current depth
+    uint32_t levelCount;
+    uint64_t levelOffset[MAX_LEVEL];
+    uint64_t levelSize[MAX_LEVEL];
+    SavedMob player;
+    KillStats kills;
+    RandomState random;
+} SaveHeader;
+
+// serialized level (or player) kept between autosaves, shared with the
+// autosave thread
+typedef struct SaveBlob_t {
+    atomic_int refs;
+    size_t length;
+    unsigned char data[];
+} SaveBlob;
+
+// buffered writer, never allocates when writing to a file
+typedef struct {
+    int fd; // file to write to, or -1 to write to blob
+    int error;
+    size_t offset; // bytes written to file
+    size_t length; // bytes in buffer
+    SaveBlob *blob;
+    size_t capacity; // bytes allocated for blob data
+    unsigned char buffer[SAVE_BUFFER_SIZE];
+} SaveWriter;
+
+// everything the autosave thread needs to write a save, one per game
+typedef struct Autosave_t {
+    pthread_t thread;
+    int started; // 1 if thread needs to be joined
+    atomic_int busy; // 1 while thread is writing
+    char filename[256];
+    SaveHeader header;
+    SaveBlob *player;
+    SaveBlob *levels[MAX_LEVEL];
+    int levelCount;
+} AutosaveJob;
+
+// bounds checked reader over the mapped snapshot
+typedef struct {
+    const unsigned char *data;
+    size_t length;
+    size_t offset;
+} SaveReader;
+
+/*************/
+/**         **/
+/**  write  **/
+/**         **/
+/*************/
+
+// append buffer to blob (memory writer)
+void save_flush_blob(SaveWriter *w)
+{
+    size_t needed = w->offset + w->length;
+    if (!w->error && needed > w->capacity)
+    {
+        size_t capacity = w->capacity ? w->capacity : SAVE_BUFFER_SIZE;
+        while (capacity < needed)
+            capacity *= 2;
+
+        SaveBlob *blob = realloc(w->blob, sizeof(SaveBlob) + capacity);
+        if (blob == NULL)
+            w->error = 1;
+        else {
+            w->blob = blob;
+            w->capacity = capacity;
+        }
+    }
+
+    if (!w->error)
+    {
+        memcpy(w->blob->data + w->offset, w->buffer, w->length);
+        w->blob->length = needed;
+    }
+
+    w->offset += w->length;
+    w->length = 0;
+}
+
+void save_flush(SaveWriter *w)
+{
+    if (w->fd < 0)
+    {
+        save_flush_blob(w);
+
+        return;
+    }
+
+    size_t done = 0;
+    while (!w->error && done < w->length)
+    {
+        ssize_t bytes = write(w->fd, w->buffer + done, w->length - done);
+        if (bytes <= 0)
+            w->error = 1;
+        else
+            done += bytes;
+    }
+
+    w->offset += w->length;
+    w->length = 0;
+}
+
+void save_write(SaveWriter *w, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    while (size > 0)
+    {
+        if (w->length == SAVE_BUFFER_SIZE)
+            save_flush(w);
+
+        size_t chunk = SAVE_BUFFER_SIZE - w->length;
+        if (chunk > size)
+            chunk = size;
+        memcpy(w->buffer + w->length, bytes, chunk);
+        w->length += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+size_t save_tell(const SaveWriter *w)
+{
+    return w->offset + w->length;
+}
+
+// pad to next block
+void save_pad(SaveWriter *w)
+{
+    static const unsigned char zero[SAVE_ALIGN] = {0};
+    size_t rem = save_tell(w) % SAVE_ALIGN;
+    if (rem)
+        save_write(w, zero, SAVE_ALIGN - rem);
+}
+
+SavedItem save_item(const Item *item)
+{
+    SavedItem saved = {0};
+    saved.id = item->id;
+    saved.kind = item_kind(item);
+    saved.type = item->type;
+    saved.amount = item->amount;
+    saved.data = item->damage;
+
+    return saved;
+}
+
+int equipped_index(const Inventory *inventory, const Item *item)
+{
+    if (item == NULL)
+        return -1;
+
+    for (int i = 0; i < inventory->itemCount; ++i)
+        if (inventory->items[i] == item)
+            return i;
+
+    return -1;
+}
+
+SavedMob save_mob(const Mob *mob)
+{
+    SavedMob saved = {0};
+    saved.x = mob->coords.x;
+    saved.y = mob->coords.y;
+    saved.hp = mob->hp;
+    saved.maxHP = mob->maxHP;
+    saved.minDamage = mob->minDamage;
+    saved.maxDamage = mob->maxDamage;
+    saved.type = mob->type;
+    saved.form = mob->form;
+    saved.symbol = mob->symbol;
+    saved.lootDepth = mob->loot.depth;
+    saved.lootKit = mob->loot.kit;
+    saved.attrs = mob->attrs;
+    saved.weapon = saved.armor = saved.readied = -1;
+    saved.pathX = mob->path ? mob->path->target.x : -1;
+    saved.pathY = mob->path ? mob->path->target.y : -1;
+    saved.rng = mob->rng;
+
+    const Inventory *inventory = mob->inventory;
+    if (inventory)
+    {
+        saved.itemCount = inventory->itemCount;
+        saved.weapon = equipped_index(inventory, inventory->equipment.weapon);
+        saved.armor = equipped_index(inventory, inventory->equipment.armor);
+        saved.readied = equipped_index(inventory, inventory->equipment.readied);
+    }
+
+    return saved;
+}
+
+void save_mob_items(SaveWriter *w, const Mob *mob)
+{
+    if (mob->inventory == NULL)
+        return;
+
+    for (int i = 0; i < mob->inventory->itemCount; ++i)
+    {
+        SavedItem saved = save_item(mob->inventory->items[i]);
+        save_write(w, &saved, sizeof(saved));
+    }
+}
+
+void unpack_bytes(SaveWriter *w, const unsigned char *packed, size_t size);
+void save_level(SaveWriter *w, const Dungeon *dungeon, const Level *level)
+{
+    // level was never loaded - copy it straight from the old snapshot
+    if (level->snapshot)
+    {
+        const SaveHeader *header = dungeon->snapshot;
+        save_write(w, level->snapshot, header->levelSize[level->depth - 1]);
+        save_pad(w);
+
+        return;
+    }
+
+    // packed levels are already a level block
+    if (level->packed)
+    {
+        unpack_bytes(w, level->packed, level->packedSize);
+
+        return;
+    }
+
+    SavedLevel saved = {0};
+    saved.depth = level->depth;
+    saved.rng = level->rng;
+    saved.width = level->map->width;
+    saved.height = level->map->height;
+    saved.upX = level->upstair_loc.x;
+    saved.upY = level->upstair_loc.y;
+    saved.downX = level->downstair_loc.x;
+    saved.downY = level->downstair_loc.y;
+    saved.mobCount = level->mobCount;
+    saved.leftTurn = level->leftTurn;
+
+    for (int i = 0; i < level->mobCount; ++i)
+        if (level->mobs[i].inventory)
+            saved.itemCount += level->mobs[i].inventory->itemCount;
+    for (int i = 0; i < level->floor.count; ++i)
+        saved.floorCount += level->floor.stacks[i].count;
+
+    save_write(w, &saved, sizeof(saved));
+
+    // terrain & explored tiles
+    for (unsigned int y = 0; y < saved.height; ++y)
+        for (unsigned int x = 0; x < saved.width; ++x)
+            save_write(w, rl_map_tile(level->map, x, y), 1);
+    save_pad(w);
+    save_write(w, level->fov->visibility, saved.width * saved.height);
+    save_pad(w);
+
+    for (int i = 0; i < level->mobCount; ++i)
+    {
+        SavedMob mob = save_mob(&level->mobs[i]);
+        save_write(w, &mob, sizeof(mob));
+    }
+    for (int i = 0; i < level->mobCount; ++i)
+        save_mob_items(w, &level->mobs[i]);
+    save_pad(w);
+
+    // stacks are in map order, bottom item first
+    for (int i = 0; i < level->floor.count; ++i)
+    {
+        const FloorStack *stack = &level->floor.stacks[i];
+        for (int j = 0; j < stack->count; ++j)
+        {
+            SavedFloorItem floor = {
+                stack->tile % level->floor.width,
+                stack->tile / level->floor.width,
+                save_item(&stack->items[j])
+            };
+            save_write(w, &floor, sizeof(floor));
+        }
+    }
+    save_pad(w);
+}
+
+SaveHeader save_header(const Game *game, const Dungeon *dungeon)
+{
+    SaveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SAVE_MAGIC, sizeof(header.magic));
+    header.version = SAVE_VERSION;
+    header.seed = dungeon->seed;
+    header.turn = dungeon->turn;
+    header.nextItemId = game->latestItemId;
+    header.depth = dungeon->level->depth;
+    header.player = save_mob(dungeon->player);
+    header.kills = dungeon->kills;
+    header.random = game->random;
+
+    return header;
+}
+
+// open temp file next to filename, so a crash never leaves half a save
+int open_save(SaveWriter *w, char *tmpname, size_t size, const char *filename)
+{
+    if (snprintf(tmpname, size, "%s.tmp", filename) >= (int) size)
+        return 0;
+
+    w->fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    w->error = 0;
+    w->offset = 0;
+    w->length = 0;
+    w->blob = NULL;
+    w->capacity = 0;
+
+    return w->fd >= 0;
+}
+
+// write final header, sync & move temp file over filename
+int close_save(SaveWriter *w, const SaveHeader *header, const char *tmpname, const char *filename)
+{
+    save_flush(w);
+    if (!w->error && pwrite(w->fd, header, sizeof(*header), 0) != sizeof(*header))
+        w->error = 1;
+    if (!w->error && fsync(w->fd) != 0)
+        w->error = 1;
+    close(w->fd);
+
+    if (w->error || rename(tmpname, filename) != 0)
+    {
+        unlink(tmpname);
+
+        return 0;
+    }
+
+    return 1;
+}
+
+int save_dungeon(const Game *game, const Dungeon *dungeon, const char *filename)
+{
+    char tmpname[256];
+    SaveWriter w;
+    if (!open_save(&w, tmpname, sizeof(tmpname), filename))
+        return 0;
+
+    SaveHeader header = save_header(game, dungeon);
+
+    // header is rewritten once level offsets are known
+    save_write(&w, &header, sizeof(header));
+    save_pad(&w);
+    save_mob_items(&w, dungeon->player);
+    save_pad(&w);
+
+    const Level *level = dungeon->level;
+    while (level->prev)
+        level = level->prev;
+    for (; level; level = level->next)
+    {
+        size_t offset = save_tell(&w);
+        save_level(&w, dungeon, level);
+        header.levelOffset[level->depth - 1] = offset;
+        header.levelSize[level->depth - 1] = save_tell(&w) - offset;
+        ++header.levelCount;
+    }
+
+    return close_save(&w, &header, tmpname, filename);
+}
+
+/*************/
+/**         **/
+/** autosave **/
+/**         **/
+/*************/
+
+void release_blob(SaveBlob *blob)
+{
+    if (blob && atomic_fetch_sub(&blob->refs, 1) == 1)
+        free(blob);
+}
+
+SaveBlob *retain_blob(SaveBlob *blob)
+{
+    atomic_fetch_add(&blob->refs, 1);
+
+    return blob;
+}
+
+// finish memory writer & return its blob, NULL on OOM
+SaveBlob *finish_blob(SaveWriter *w)
+{
+    save_pad(w);
+    save_flush(w);
+    if (w->error || w->blob == NULL)
+    {
+        free(w->blob);
+
+        return NULL;
+    }
+
+    atomic_init(&w->blob->refs, 1);
+
+    return w->blob;
+}
+
+void *write_autosave(void *arg)
+{
+    AutosaveJob *job = arg;
+
+    char tmpname[256];
+    SaveWriter w;
+    if (open_save(&w, tmpname, sizeof(tmpname), job->filename))
+    {
+        save_write(&w, &job->header, sizeof(job->header));
+        save_pad(&w);
+        save_write(&w, job->player->data, job->player->length);
+
+        for (int i = 0; i < job->levelCount; ++i)
+        {
+            job->header.levelOffset[i] = save_tell(&w);
+            job->header.levelSize[i] = job->levels[i]->length;
+            save_write(&w, job->levels[i]->data, job->levels[i]->length);
+        }
+        job->header.levelCount = job->levelCount;
+
+        close_save(&w, &job->header, tmpname, job->filename);
+    }
+
+    release_blob(job->player);
+    for (int i = 0; i < job->levelCount; ++i)
+        release_blob(job->levels[i]);
+
+    atomic_store(&job->busy, 0);
+
+    return NULL;
+}
+
+void finish_autosave(Game *game)
+{
+    AutosaveJob *job = game->autosave;
+    if (job && job->started)
+    {
+        pthread_join(job->thread, NULL);
+        job->started = 0;
+    }
+}
+
+void forget_autosave(Level *level)
+{
+    release_blob(level->autosave);
+    level->autosave = NULL;
+    level->dirty = 1;
+}
+
+int autosave(Game *game, Dungeon *dungeon, const char *filename)
+{
+    if (game->autosave == NULL)
+    {
+        game->autosave = malloc(sizeof(AutosaveJob));
+        if (game->autosave == NULL)
+            return 0;
+        game->autosave->started = 0;
+        atomic_init(&game->autosave->busy, 0);
+    }
+
+    // never stall a turn - skip if last autosave is still being written
+    AutosaveJob *job = game->autosave;
+    if (atomic_load(&job->busy))
+        return 0;
+    finish_autosave(game);
+
+    if (snprintf(job->filename, sizeof(job->filename), "%s", filename) >= (int) sizeof(job->filename))
+        return 0;
+    job->header = save_header(game, dungeon);
+    job->levelCount = 0;
+
+    SaveWriter w = { .fd = -1 };
+    save_mob_items(&w, dungeon->player);
+    job->player = finish_blob(&w);
+    if (job->player == NULL)
+        return 0;
+
+    // copy levels changed since last autosave, unchanged levels share
+    // the copy the previous autosave made
+    Level *level = dungeon->level;
+    while (level->prev)
+        level = level->prev;
+    for (; level; level = level->next)
+    {
+        // packed levels don't keep an unpacked copy, that's what they save
+        if (level->packed)
+        {
+            SaveWriter w = { .fd = -1 };
+            save_level(&w, dungeon, level);
+            SaveBlob *blob = finish_blob(&w);
+            if (blob == NULL)
+                break;
+
+            job->levels[job->levelCount++] = blob;
+            continue;
+        }
+
+        if (level->dirty || level->autosave == NULL)
+        {
+            SaveWriter w = { .fd = -1 };
+            save_level(&w, dungeon, level);
+            SaveBlob *blob = finish_blob(&w);
+            if (blob == NULL)
+                break;
+
+            release_blob(level->autosave);
+            level->autosave = blob;
+            level->dirty = 0;
+        }
+
+        job->levels[job->levelCount++] = retain_blob(level->autosave);
+    }
+
+    // OOM - drop snapshot
+    if (level != NULL)
+    {
+        release_blob(job->player);
+        for (int i = 0; i < job->levelCount; ++i)
+            release_blob(job->levels[i]);
+
+        return 0;
+    }
+
+    atomic_store(&job->busy, 1);
+    if (pthread_create(&job->thread, NULL, write_autosave, job) != 0)
+    {
+        // write it on this thread instead
+        write_autosave(job);
+
+        return 1;
+    }
+    job->started = 1;
+
+    return 1;
+}
+
+/*************/
+/**         **/
+/**  load   **/
+/**         **/
+/*************/
+
+// return pointer to next size bytes, or NULL if past end of snapshot
+const void *save_read(SaveReader *r, size_t size)
+{
+    // every block starts aligned
+    size_t offset = (r->offset + SAVE_ALIGN - 1) / SAVE_ALIGN * SAVE_ALIGN;
+    if (offset > r->length || size > r->length - offset)
+        return NULL;
+
+    r->offset = offset + size;
+
+    return r->data + offset;
+}
+
+Item *load_item(const SavedItem *saved)
+{
+    const Item *prototype = item_prototype(saved->kind);
+    if (prototype == NULL)
+        return NULL;
+
+    Item *item = malloc(sizeof(Item));
+    if (item == NULL)
+        return NULL;
+
+    *item = *prototype;
+    item->id = saved->id;
+    item->type = saved->type;
+    item->amount = saved->amount;
+    item->damage = saved->data;
+
+    return item;
+}
+
+// restore mob from saved record, items are read from the items array
+int load_mob(Game *game, Mob *mob, const SavedMob *saved, const SavedItem *items)
+{
+    *mob = (Mob) {0};
+    mob->coords = RL_XY(saved->x, saved->y);
+    mob->hp = saved->hp;
+    mob->maxHP = saved->maxHP;
+    mob->minDamage = saved->minDamage;
+    mob->maxDamage = saved->maxDamage;
+    mob->type = saved->type;
+    mob->form = saved->form;
+    mob->symbol = saved->symbol;
+    mob->loot.depth = saved->lootDepth;
+    mob->loot.kit = saved->lootKit;
+    mob->attrs = saved->attrs;
+    mob->rng = saved->rng;
+
+    for (int i = 0; i < saved->itemCount; ++i)
+    {
+        Item *item = load_item(&items[i]);
+        if (item == NULL || !give_mob_item(game, mob, item))
+        {
+            free(item);
+
+            return 0;
+        }
+    }
+
+    if (mob->inventory)
+    {
+        Inventory *inventory = mob->inventory;
+        if (saved->weapon >= 0 && saved->weapon < inventory->itemCount)
+            inventory->equipment.weapon = inventory->items[saved->weapon];
+        if (saved->armor >= 0 && saved->armor < inventory->itemCount)
+            inventory->equipment.armor = inventory->items[saved->armor];
+        if (saved->readied >= 0 && saved->readied < inventory->itemCount)
+            inventory->equipment.readied = inventory->items[saved->readied];
+    }
+
+    return 1;
+}
+
+int load_level_snapshot(Game *game, Level *level, SaveReader *r, Mob *player)
+{
+    const SavedLevel *saved = save_read(r, sizeof(SavedLevel));
+    if (saved == NULL || saved->depth != level->depth ||
+            saved->width != level->width || saved->height != level->height ||
+            saved->mobCount > MAX_MOBS)
+        return 0;
+
+    size_t area = saved->width * saved->height;
+    const RL_Byte *tiles = save_read(r, area);
+    const RL_Byte *visibility = save_read(r, area);
+    const SavedMob *mobs = save_read(r, saved->mobCount * sizeof(SavedMob));
+    const SavedItem *items = save_read(r, saved->itemCount * sizeof(SavedItem));
+    const SavedFloorItem *floor = save_read(r, saved->floorCount * sizeof(SavedFloorItem));
+    if (!tiles || !visibility || !mobs || !items || !floor)
+        return 0;
+
+    level->player = player;
+    level->rng = saved->rng;
+    level->upstair_loc = RL_XY(saved->upX, saved->upY);
+    level->downstair_loc = RL_XY(saved->downX, saved->downY);
+    level->leftTurn = saved->leftTurn;
+
+    level->map = rl_map_create(saved->width, saved->height);
+    level->fov = rl_fov_create(saved->width, saved->height);
+    if (level->map == NULL || level->fov == NULL)
+        return 0;
+    for (unsigned int y = 0; y < saved->height; ++y)
+        for (unsigned int x = 0; x < saved->width; ++x)
+            *rl_map_tile(level->map, x, y) = tiles[y*saved->width + x];
+    hash_map(game, level);
+    if (!index_tiles(level))
+        return 0;
+    memcpy(level->fov->visibility, visibility, area);
+
+    uint32_t itemIndex = 0;
+    for (uint32_t i = 0; i < saved->mobCount; ++i)
+    {
+        if (mobs[i].itemCount < 0 || mobs[i].itemCount > (int) (saved->itemCount - itemIndex))
+            return 0;
+
+        Mob mob;
+        if (!load_mob(game, &mob, &mobs[i], items + itemIndex))
+            return 0;
+        mob.depth = level->depth;
+        Mob *loaded = insert_mob(game, mob, level->mobs, &level->mobCount);
+        itemIndex += mobs[i].itemCount;
+
+        // the graph is scored again from the map
+        int x = mobs[i].pathX, y = mobs[i].pathY;
+        if (x >= 0 && y >= 0 && x < (int) level->width && y < (int) level->height)
+            score_mob_path(loaded, level->map, RL_XY(x, y));
+    }
+
+    for (uint32_t i = 0; i < saved->floorCount; ++i)
+    {
+        int x = floor[i].x, y = floor[i].y;
+        if (x < 0 || y < 0 || x >= (int) level->width || y >= (int) level->height)
+            return 0;
+
+        Item *item = load_item(&floor[i].item);
+        if (item == NULL)
+            return 0;
+        drop_item(game, level, RL_XY(x, y), item);
+    }
+
+    return 1;
+}
+
+Dungeon *load_dungeon(Game *game, const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(SaveHeader))
+    {
+        close(fd);
+
+        return NULL;
+    }
+
+    void *snapshot = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (snapshot == MAP_FAILED)
+        return NULL;
+
+    Dungeon *dungeon = NULL;
+    SaveReader r = { snapshot, st.st_size, 0 };
+    const SaveHeader *header = save_read(&r, sizeof(SaveHeader));
+    if (memcmp(header->magic, SAVE_MAGIC, sizeof(header->magic)) != 0 ||
+            header->version != SAVE_VERSION ||
+            header->levelCount < 1 || header->levelCount > MAX_LEVEL ||
+            header->depth < 1 || header->depth > (int) header->levelCount ||
+            header->player.itemCount < 0 || header->player.itemCount > MAX_INVENTORY_ITEMS)
+        goto fail;
+
+    const SavedItem *playerItems = save_read(&r, header->player.itemCount * sizeof(SavedItem));
+    game->random = header->random;
+    game->hash = 0;
+
+    dungeon = malloc(sizeof(Dungeon));
+    Mob *player = malloc(sizeof(Mob));
+    if (dungeon == NULL || player == NULL)
+    {
+        free(player);
+        free(dungeon);
+        dungeon = NULL;
+
+        goto fail;
+    }
+
+    *player = (Mob) {0};
+    dungeon->player = player;
+    dungeon->turn = header->turn;
+    dungeon->seed = header->seed;
+    dungeon->width = MAX_WIDTH;
+    dungeon->height = MAX_HEIGHT;
+    dungeon->residentDistance = RESIDENT_DISTANCE;
+    dungeon->kills = header->kills;
+    dungeon->snapshot = snapshot;
+    dungeon->snapshotSize = st.st_size;
+    dungeon->snapshotLevels = 0;
+    dungeon->pregenerate = 0;
+    dungeon->pregen = NULL;
+    dungeon->level = NULL;
+    if (playerItems == NULL || !load_mob(game, player, &header->player, playerItems))
+        goto fail;
+    game->latestItemId = header->nextItemId;
+
+    // link up every level, their contents stay in the snapshot for now
+    Level *prev = NULL;
+    for (uint32_t depth = 1; depth <= header->levelCount; ++depth)
+    {
+        uint64_t offset = header->levelOffset[depth - 1];
+        uint64_t size = header->levelSize[depth - 1];
+        if (offset > (uint64_t) st.st_size || size > (uint64_t) st.st_size - offset || size < sizeof(SavedLevel))
+            goto fail;
+
+        // the map size comes first, the rest is loaded with the level
+        const SavedLevel *saved = (const SavedLevel*) ((const unsigned char*) snapshot + offset);
+        if (saved->width < MIN_MAP_SIZE || saved->width > MAX_MAP_SIZE ||
+                saved->height < MIN_MAP_SIZE || saved->height > MAX_MAP_SIZE)
+            goto fail;
+        if (depth == 1)
+        {
+            dungeon->width = saved->width;
+            dungeon->height = saved->height;
+        }
+
+        Level *level = create_level(game, depth, saved->width, saved->height);
+        if (level == NULL)
+            goto fail;
+
+        level->snapshot = (const unsigned char*) snapshot + offset;
+        ++dungeon->snapshotLevels;
+
+        level->prev = prev;
+        if (prev)
+            prev->next = level;
+        // linked levels are found from here when destroying the dungeon
+        if (level->depth <= header->depth)
+            dungeon->level = level;
+        prev = level;
+    }
+
+    if (!load_level(game, dungeon, dungeon->level))
+        goto fail;
+
+    return dungeon;
+
+fail:
+    // also unmaps the snapshot
+    if (dungeon)
+        destroy_dungeon(dungeon);
+    else
+        munmap(snapshot, st.st_size);
+
+    return NULL;
+}
+
+int unpack_level(Game *game, Dungeon *dungeon, Level *level);
+int load_level(Game *game, Dungeon *dungeon, Level *level)
+{
+    if (level->packed)
+        return unpack_level(game, dungeon, level);
+    if (level->snapshot == NULL)
+        return 1;
+
+    const SaveHeader *header = dungeon->snapshot;
+    SaveReader r = { level->snapshot, header->levelSize[level->depth - 1], 0 };
+
+    if (!load_level_snapshot(game, level, &r, dungeon->player))
+        return 0;
+
+    level->snapshot = NULL;
+
+    // unmap once the last level has been loaded
+    if (--dungeon->snapshotLevels == 0)
+    {
+        munmap(dungeon->snapshot, dungeon->snapshotSize);
+        dungeon->snapshot = NULL;
+        dungeon->snapshotSize = 0;
+    }
+
+    return 1;
+}
+
+/*************/
+/**         **/
+/**  pack   **/
+/**         **/
+/*************/
+
+size_t pack_bytes(unsigned char *packed, const unsigned char *data, size_t length);
+int pack_level(Dungeon *dungeon, Level *level)
+{
+    // levels still in a save snapshot aren't in memory either
+    if (level->packed || level->snapshot || level->map == NULL)
+        return 1;
+
+    SaveWriter w = { .fd = -1 };
+    save_level(&w, dungeon, level);
+    SaveBlob *blob = finish_blob(&w);
+    if (blob == NULL)
+        return 0;
+
+    // worst case is a count byte per 128 bytes
+    unsigned char *packed = malloc(blob->length + blob->length / 128 + 1);
+    if (packed == NULL)
+    {
+        release_blob(blob);
+
+        return 0;
+    }
+    size_t size = pack_bytes(packed, blob->data, blob->length);
+    release_blob(blob);
+
+    unsigned char *shrunk = realloc(packed, size);
+    level->packedHash = level_hash(level);
+    level->packed = shrunk ? shrunk : packed;
+    level->packedSize = size;
+    forget_autosave(level);
+    clear_level(level);
+
+    return 1;
+}
+
+int unpack_level(Game *game, Dungeon *dungeon, Level *level)
+{
+    SaveWriter w = { .fd = -1 };
+    unpack_bytes(&w, level->packed, level->packedSize);
+    SaveBlob *blob = finish_blob(&w);
+    if (blob == NULL || !init_floor(&level->floor, level->width, level->height, level->arena))
+    {
+        release_blob(blob);
+
+        return 0;
+    }
+
+    // level never left the world hash, don't add it again
+    uint64_t hash = game->hash;
+    SaveReader r = { blob->data, blob->length, 0 };
+    int loaded = load_level_snapshot(game, level, &r, dungeon->player);
+    game->hash = hash;
+    release_blob(blob);
+    if (!loaded)
+        return 0;
+
+    free(level->packed);
+    level->packed = NULL;
+    level->packedSize = 0;
+    level->packedHash = 0;
+
+    return 1;
+}
+
+// PackBits, packed needs room for length + length / 128 + 1 bytes
+// returns packed size
+size_t pack_bytes(unsigned char *packed, const unsigned char *data, size_t length)
+{
+    size_t size = 0, i = 0;
+    while (i < length)
+    {
+        // run of the same byte
+        size_t run = 1;
+        while (i + run < length && run < 128 && data[i + run] == data[i])
+            ++run;
+        if (run >= 3)
+        {
+            packed[size++] = 257 - run;
+            packed[size++] = data[i];
+            i += run;
+
+            continue;
+        }
+
+        // literals until the next run of 3
+        size_t literal = 0;
+        while (i + literal < length && literal < 128 &&
+                !(i + literal + 2 < length &&
+                  data[i + literal] == data[i + literal + 1] &&
+                  data[i + literal] == data[i + literal + 2]))
+            ++literal;
+        packed[size++] = literal - 1;
+        memcpy(packed + size, data + i, literal);
+        size += literal;
+        i += literal;
+    }
+
+    return size;
+}
+
+// write packed bytes out as they were
+void unpack_bytes(SaveWriter *w, const unsigned char *packed, size_t size)
+{
+    unsigned char run[128];
+    size_t i = 0;
+    while (i < size)
+    {
+        unsigned char n = packed[i++];
+        if (n < 128)
+        {
+            size_t literal = (size_t) n + 1 < size - i ? (size_t) n + 1 : size - i;
+            save_write(w, packed + i, literal);
+            i += literal;
+        }
+        else if (n > 128 && i < size)
+        {
+            memset(run, packed[i++], 257 - n);
+            save_write(w, run, 257 - n);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#define SAVE_FILE        "simplerl.sav"
+#define SAVE_VERSION     4
+#define SAVE_BUFFER_SIZE 4096 // bytes buffered before each write
+#define AUTOSAVE_TURNS   100  // turns between autosaves
+
+#include "dungeon.h"
+
+// write dungeon snapshot (and next item ID & RNG streams of game) to file (replaced
+// atomically)
+// returns 0 on error
+int save_dungeon(const Game *game, const Dungeon *dungeon, const char *filename);
+
+// snapshot levels changed since the last autosave of game & write the
+// snapshot to file on a background thread
+// returns 0 if skipped (previous autosave still being written, or OOM)
+int autosave(Game *game, Dungeon *dungeon, const char *filename);
+
+// wait for the autosave thread of game to finish writing
+void finish_autosave(Game *game);
+
+// drop level data kept for the next autosave (i.e. before freeing level)
+void forget_autosave(Level *level);
+
+// map dungeon snapshot from file, only the current level is loaded
+// right away (the rest are loaded by load_level when entered)
+// next item ID, RNG streams & world hash are restored to game
+// returns NULL on error (i.e. missing file, bad version or OOM)
+Dungeon *load_dungeon(Game *game, const char *filename);
+
+// finish loading level from the dungeon snapshot or unpack it, does
+// nothing if the level is already in memory
+// returns 0 on error
+int load_level(Game *game, Dungeon *dungeon, Level *level);
+
+// compress level in memory & free the rest of it until load_level, it
+// still counts towards the world hash (mobs lose their paths, but keep
+// walking towards the same tile once unpacked)
+// returns 0 on OOM, level is left as it was
+int pack_level(Dungeon *dungeon, Level *level);
+
+#endif
@@ -0,0 +1,300 @@
+#include "table.h"
+#include "dungeon.h"
+
+#define ITEM_TYPES (ITEM_SCROLL + 1)
+
+// spawn table, difficulty ranges must cover 1 - MAX_DIFFICULTY
+static const SpawnEntry spawnTable[] = {
+    // symbol, type, form, hp, min dmg, max dmg, min difficulty, max difficulty, weight
+    { 'r', MOB_ENEMY,  MOB_FORM_QUADRAPED, 4, 1, 2, 1, 1, 1 }, // rat
+    { 'k', MOB_ENEMY,  MOB_FORM_BIPED, 4, 2, 3, 2, 2, 1 }, // kobold
+    { 'g', MOB_ENEMY,  MOB_FORM_BIPED, 5, 2, 3, 3, 3, 1 }, // goblin
+    { 'o', MOB_ENEMY,  MOB_FORM_BIPED, 6, 2, 4, 4, 5, 1 }, // orc
+    { 'h', MOB_ENEMY,  MOB_FORM_BIPED, 8, 3, 4, 6, 7, 1 }, // hobgoblin
+    { 'O', MOB_ENEMY,  MOB_FORM_BIPED, 12, 4, 8, 8, 9, 1 }, // ogre
+    { 'd', MOB_ENEMY,  MOB_FORM_QUADRAPED & MOB_FORM_FLYING, 15, 8, 12, 10, 14, 1 }, // drake
+    // TODO breath effects
+    // TODO dragons always have dragonhide
+    { 'D', MOB_DRAGON, MOB_FORM_QUADRAPED & MOB_FORM_FLYING, 20, 12, 15, 15, 18, 1 }, // dragon
+    // TODO drain effects
+    // TODO demons always have cool sword
+    { '&', MOB_DEMON,  MOB_FORM_BIPED & MOB_FORM_FLYING, 30, 15, 20, 19, MAX_DIFFICULTY, 1 }, // demon
+};
+
+// percent chance per point of difficulty for mob to carry each kit item
+#define LOOT_WEAPON_CHANCE 10
+#define LOOT_ARMOR_CHANCE  5
+#define LOOT_POTION_CHANCE 5
+#define LOOT_SCROLL_CHANCE 5 // only rolled if mob has no potion
+
+// loot table, weights are per depth band (1-2, 3-5, 6+)
+static const LootEntry lootTable[] = {
+    { ITEM_ARMOR, leather, { 75, 25, 0 } },
+    { ITEM_ARMOR, ring_mail, { 25, 50, 20 } },
+    { ITEM_ARMOR, splint_mail, { 0, 25, 15 } },
+    { ITEM_ARMOR, plate_mail, { 0, 0, 40 } },
+    { ITEM_ARMOR, full_plate, { 0, 0, 10 } },
+    // TODO probably want to actually generate dragonhide on dragons
+    { ITEM_ARMOR, dragon_hide, { 0, 0, 10 } },
+    { ITEM_ARMOR, dragon_plate, { 0, 0, 5 } },
+
+    // TODO artifact/unique weapons
+    { ITEM_WEAPON, dagger, { 50, 20, 0 } },
+    { ITEM_WEAPON, short_sword, { 25, 0, 0 } },
+    { ITEM_WEAPON, quarterstaff, { 25, 0, 0 } },
+    { ITEM_WEAPON, arrow, { 0, 10, 20 } },
+    { ITEM_WEAPON, mace, { 0, 20, 0 } },
+    { ITEM_WEAPON, long_sword, { 0, 25, 0 } },
+    { ITEM_WEAPON, bastard_sword, { 0, 25, 15 } },
+    { ITEM_WEAPON, flail, { 0, 0, 40 } },
+    { ITEM_WEAPON, masterwork_sword, { 0, 0, 10 } },
+    { ITEM_WEAPON, masterwork_bastard_sword, { 0, 0, 10 } },
+    { ITEM_WEAPON, silver_sword, { 0, 0, 5 } },
+
+    { ITEM_POTION, healing_potion, { 49, 49, 49 } },
+    { ITEM_POTION, acidic_potion, { 51, 51, 51 } },
+
+    { ITEM_SCROLL, scroll_of_fire, { 32, 32, 32 } },
+    { ITEM_SCROLL, scroll_of_teleportation, { 68, 68, 68 } },
+    /* Not really useful until we generate random item names... */
+    /* { ITEM_SCROLL, scroll_of_identify, { 0, 0, 0 } }, */
+};
+
+#define SPAWN_ENTRIES (sizeof(spawnTable) / sizeof(*spawnTable))
+#define LOOT_ENTRIES  (sizeof(lootTable) / sizeof(*lootTable))
+
+// alias tables indexed by depth (index 0 unused)
+static AliasTable spawnAlias[MAX_LEVEL + 1];
+static Spawn spawnOutcomes[MAX_LEVEL + 1][MAX_ALIAS_OUTCOMES];
+static AliasTable lootAlias[MAX_LEVEL + 1][ITEM_TYPES];
+static const LootEntry *lootOutcomes[MAX_LEVEL + 1][ITEM_TYPES][MAX_ALIAS_OUTCOMES];
+
+// loot kit alias tables indexed by difficulty, outcome is the LOOT flags
+static AliasTable kitAlias[MAX_DIFFICULTY + 1];
+
+// one item per loot table row, gold is the last kind
+#define ITEM_KINDS (LOOT_ENTRIES + 1)
+static Item prototypes[ITEM_KINDS];
+
+int clamp_depth(int depth)
+{
+    if (depth < 1) return 1;
+    if (depth > MAX_LEVEL) return MAX_LEVEL;
+
+    return depth;
+}
+
+int loot_band(int depth)
+{
+    if (depth <= 2)
+        return 0;
+    else if (depth <= 5)
+        return 1;
+    else
+        return 2;
+}
+
+float percent_chance(int percent)
+{
+    if (percent > 100) percent = 100;
+
+    return percent / 100.0f;
+}
+
+void init_tables()
+{
+    float weights[MAX_ALIAS_OUTCOMES];
+
+    for (int depth = 1; depth <= MAX_LEVEL; ++depth)
+    {
+        // each difficulty roll between depth & depth*2 spawns one species
+        int count = 0;
+        for (int difficulty = depth; difficulty <= depth*2; ++difficulty)
+        {
+            for (size_t i = 0; i < SPAWN_ENTRIES; ++i)
+            {
+                const SpawnEntry *species = &spawnTable[i];
+                if (difficulty >= species->minDifficulty && difficulty <= species->maxDifficulty)
+                {
+                    spawnOutcomes[depth][count] = (Spawn) { species, difficulty };
+                    weights[count++] = species->weight;
+                    break;
+                }
+            }
+        }
+        build_alias_table(&spawnAlias[depth], weights, count);
+
+        // item kinds of each type for the depth band
+        for (int type = 0; type < ITEM_TYPES; ++type)
+        {
+            count = 0;
+            for (size_t i = 0; i < LOOT_ENTRIES; ++i)
+            {
+                const LootEntry *loot = &lootTable[i];
+                if (loot->type == type && loot->weight[loot_band(depth)] > 0)
+                {
+                    lootOutcomes[depth][type][count] = loot;
+                    weights[count++] = loot->weight[loot_band(depth)];
+                }
+            }
+            lootAlias[depth][type].count = 0;
+            build_alias_table(&lootAlias[depth][type], weights, count);
+        }
+    }
+
+    for (int difficulty = 1; difficulty <= MAX_DIFFICULTY; ++difficulty)
+    {
+        float weapon = percent_chance(difficulty * LOOT_WEAPON_CHANCE);
+        float armor = percent_chance(difficulty * LOOT_ARMOR_CHANCE);
+        float potion = percent_chance(difficulty * LOOT_POTION_CHANCE);
+        float scroll = (1 - potion) * percent_chance(difficulty * LOOT_SCROLL_CHANCE);
+
+        // joint chance of every combination of kit flags
+        for (int kit = 0; kit < 16; ++kit)
+        {
+            float w = (kit & LOOT_WEAPON ? weapon : 1 - weapon) *
+                (kit & LOOT_ARMOR ? armor : 1 - armor);
+
+            if ((kit & LOOT_POTION) && (kit & LOOT_SCROLL))
+                w = 0;
+            else if (kit & LOOT_POTION)
+                w *= potion;
+            else if (kit & LOOT_SCROLL)
+                w *= scroll;
+            else
+                w *= 1 - potion - scroll;
+
+            weights[kit] = w > 0 ? w : 0;
+        }
+        build_alias_table(&kitAlias[difficulty], weights, 16);
+    }
+
+    // keep a copy of each item kind (for its names), outside of any game
+    for (size_t i = 0; i < ITEM_KINDS; ++i)
+    {
+        Item *item = i < LOOT_ENTRIES ? lootTable[i].create(NULL) : create_item(NULL, 1, ITEM_GOLD);
+        if (item == NULL)
+            continue;
+        prototypes[i] = *item;
+        free(item);
+    }
+}
+
+int build_alias_table(AliasTable *table, const float *weights, int count)
+{
+    if (count <= 0 || count > MAX_ALIAS_OUTCOMES)
+        return 0;
+
+    float total = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (weights[i] < 0)
+            return 0;
+        total += weights[i];
+    }
+    if (total <= 0)
+        return 0;
+
+    // Vose's method - pair each under-full column with an over-full one
+    float scaled[MAX_ALIAS_OUTCOMES];
+    int small[MAX_ALIAS_OUTCOMES], large[MAX_ALIAS_OUTCOMES];
+    int smallCount = 0, largeCount = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        scaled[i] = weights[i] * count / total;
+        if (scaled[i] < 1)
+            small[smallCount++] = i;
+        else
+            large[largeCount++] = i;
+    }
+
+    while (smallCount > 0 && largeCount > 0)
+    {
+        int s = small[--smallCount];
+        int l = large[--largeCount];
+
+        table->prob[s] = (int) (scaled[s] * ALIAS_PRECISION + 0.5f);
+        table->alias[s] = l;
+
+        scaled[l] = (scaled[l] + scaled[s]) - 1;
+        if (scaled[l] < 1)
+            small[smallCount++] = l;
+        else
+            large[largeCount++] = l;
+    }
+
+    // leftovers are full columns (or rounding error)
+    while (largeCount > 0)
+    {
+        int l = large[--largeCount];
+        table->prob[l] = ALIAS_PRECISION;
+        table->alias[l] = l;
+    }
+    while (smallCount > 0)
+    {
+        int s = small[--smallCount];
+        table->prob[s] = ALIAS_PRECISION;
+        table->alias[s] = s;
+    }
+
+    table->count = count;
+
+    return 1;
+}
+
+int sample_alias(const AliasTable *table, RNG *rng)
+{
+    // single roll picks both the column & the biased coin
+    int r = generate(rng, 0, table->count * ALIAS_PRECISION - 1);
+    int i = r / ALIAS_PRECISION;
+
+    if (r % ALIAS_PRECISION < table->prob[i])
+        return i;
+    else
+        return table->alias[i];
+}
+
+Spawn sample_spawn(int depth, RNG *rng)
+{
+    depth = clamp_depth(depth);
+
+    return spawnOutcomes[depth][sample_alias(&spawnAlias[depth], rng)];
+}
+
+int sample_loot_kit(int difficulty, RNG *rng)
+{
+    if (difficulty < 1) difficulty = 1;
+    if (difficulty > MAX_DIFFICULTY) difficulty = MAX_DIFFICULTY;
+
+    return sample_alias(&kitAlias[difficulty], rng);
+}
+
+const LootEntry *sample_loot(int depth, int type, RNG *rng)
+{
+    if (type < 0 || type >= ITEM_TYPES)
+        return NULL;
+
+    depth = clamp_depth(depth);
+    if (lootAlias[depth][type].count == 0)
+        return NULL;
+
+    return lootOutcomes[depth][type][sample_alias(&lootAlias[depth][type], rng)];
+}
+
+int item_kind(const Item *item)
+{
+    // item names are unique per kind
+    for (size_t i = 0; i < ITEM_KINDS; ++i)
+        if (prototypes[i].name == item->name)
+            return i;
+
+    return -1;
+}
+
+const Item *item_prototype(int kind)
+{
+    if (kind < 0 || kind >= (int) ITEM_KINDS || prototypes[kind].name == NULL)
+        return NULL;
+
+    return &prototypes[kind];
+}
@@ -0,0 +1,75 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#define MAX_ALIAS_OUTCOMES 32
+#define ALIAS_PRECISION    4096 // fixed point scale of alias probabilities
+
+#define MAX_DIFFICULTY 20 // highest difficulty create_mob can roll (MAX_LEVEL*2)
+#define LOOT_BANDS     3  // depth bands of the loot table (1-2, 3-5, 6+)
+
+// loot kit flags, rolled once per biped mob
+#define LOOT_WEAPON 1
+#define LOOT_ARMOR  2
+#define LOOT_POTION 4
+#define LOOT_SCROLL 8
+#define LOOT_GOLD   16
+
+#include "item.h"
+#include "random.h"
+
+// Walker alias table for O(1) weighted sampling
+typedef struct {
+    int count;
+    int prob[MAX_ALIAS_OUTCOMES]; // chance (out of ALIAS_PRECISION) to keep column
+    int alias[MAX_ALIAS_OUTCOMES]; // outcome to use otherwise
+} AliasTable;
+
+// one row of the spawn table per mob species
+typedef struct {
+    char symbol;
+    int type; // one of MOB consts
+    int form; // MOB_FORM flags
+    int hp;
+    int minDamage, maxDamage;
+    int minDifficulty, maxDifficulty; // difficulty rolls that spawn this species
+    int weight; // relative weight of each difficulty roll
+} SpawnEntry;
+
+// one row of the loot table per item kind
+typedef struct {
+    int type; // one of ITEM consts
+    Item *(*create)(Game *game);
+    int weight[LOOT_BANDS]; // relative weight per depth band
+} LootEntry;
+
+// spawn outcome for a depth
+typedef struct {
+    const SpawnEntry *species;
+    int difficulty;
+} Spawn;
+
+// build the alias tables from the spawn & loot tables (once at startup)
+void init_tables();
+
+// build alias table from weights, returns 0 on invalid input
+int build_alias_table(AliasTable *table, const float *weights, int count);
+
+// pick an outcome index from the table
+int sample_alias(const AliasTable *table, RNG *rng);
+
+// pick a random species & difficulty for the specified dungeon depth
+Spawn sample_spawn(int depth, RNG *rng);
+
+// pick random LOOT kit flags for a mob of the specified difficulty
+int sample_loot_kit(int difficulty, RNG *rng);
+
+// pick a random item kind of ITEM type for the specified dungeon depth
+const LootEntry *sample_loot(int depth, int type, RNG *rng);
+
+// return item kind (loot table row, or gold) of item, -1 if unknown
+int item_kind(const Item *item);
+
+// return item of kind with default values, NULL if unknown
+const Item *item_prototype(int kind);
+
+#endif
@@ -0,0 +1,214 @@
+#include "term.h"
+#include "game.h"
+#include "message.h"
+#include "context.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TERM_MESSAGE_X (MAX_WIDTH / 2) // messages are drawn right of the status
+
+int term_printf(Output *out, const char *format, ...);
+int term_symbol(Output *out, SYMBOL symbol);
+int term_color(int colorPair);
+
+int output_write(Output *out, const char *data, size_t length)
+{
+    if (out->length + length > out->capacity)
+    {
+        size_t capacity = out->capacity ? out->capacity : 4096;
+        while (capacity < out->length + length)
+            capacity *= 2;
+
+        char *grown = realloc(out->data, capacity);
+        if (grown == NULL)
+            return 0;
+
+        out->data = grown;
+        out->capacity = capacity;
+    }
+
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+
+    return 1;
+}
+
+void output_consume(Output *out, size_t count)
+{
+    if (count >= out->length)
+    {
+        out->length = 0;
+
+        return;
+    }
+
+    memmove(out->data, out->data + count, out->length - count);
+    out->length -= count;
+}
+
+void output_free(Output *out)
+{
+    free(out->data);
+    *out = (Output) {0};
+}
+
+int render_term(Game *game, const Dungeon *dungeon, Output *out, int full)
+{
+    // store previous buffer for comparison
+    DrawTile prevDrawBuffer[MAX_HEIGHT][MAX_WIDTH];
+    memcpy(prevDrawBuffer, game->drawBuffer, sizeof(DrawTile) * MAX_HEIGHT * MAX_WIDTH);
+    RL_Point camera = game->camera;
+
+    render_frame(game, dungeon);
+
+    int ok = term_printf(out, full ? "\033[?25l\033[0m\033[2J" : "\033[?25l");
+
+    // let the client scroll rows still in view when the camera moved up or
+    // down, only what scrolled in is sent below (sideways is just redrawn,
+    // the client's width isn't known to shift rows safely)
+    int dy = game->camera.y - camera.y, height = game->viewHeight;
+    if (!full && dy && abs(dy) < height)
+    {
+        scroll_frame(prevDrawBuffer, game->viewWidth, height, 0, dy);
+        ok = ok && term_printf(out, "\033[0m\033[1;%dr\033[%d%c\033[r",
+                height, abs(dy), dy > 0 ? 'S' : 'T');
+    }
+
+    // only move the cursor & change colors when needed
+    int cursorX = -1, cursorY = -1;
+    int colorPair = -1, attr = -1;
+    for (int y = 0; y < MAX_HEIGHT; ++y)
+    {
+        for (int x = 0; x < MAX_WIDTH; ++x)
+        {
+            const DrawTile *tile = &game->drawBuffer[y][x];
+            if (!full &&
+                    tile->symbol == prevDrawBuffer[y][x].symbol &&
+                    tile->attr == prevDrawBuffer[y][x].attr &&
+                    tile->colorPair == prevDrawBuffer[y][x].colorPair)
+                continue;
+
+            if (x != cursorX || y != cursorY)
+                ok = ok && term_printf(out, "\033[%d;%dH", y + 1, x + 1);
+            if (game->hasColor && (tile->colorPair != colorPair || tile->attr != attr))
+            {
+                ok = ok && term_printf(out, "\033[0;%s%dm", tile->attr ? "1;" : "", term_color(tile->colorPair));
+                colorPair = tile->colorPair;
+                attr = tile->attr;
+            }
+            ok = ok && term_symbol(out, tile->symbol ? tile->symbol : ' ');
+
+            cursorX = x + 1;
+            cursorY = y;
+        }
+    }
+
+    // status area & messages are redrawn every frame, like draw_status
+    const Mob *player = dungeon->player;
+    ok = ok && term_printf(out, "\033[0m");
+    for (int y = 0; y < MAX_MESSAGES; ++y)
+        ok = ok && term_printf(out, "\033[%d;1H\033[K", MAX_HEIGHT + y + 1);
+    ok = ok && term_printf(out, "\033[%d;1HHP: %d / %d", MAX_HEIGHT + 1, player->hp, player->maxHP);
+    ok = ok && term_printf(out, "\033[%d;1HLVL: %d, EXP: %d", MAX_HEIGHT + 2, player->attrs.level, player->attrs.exp);
+    ok = ok && term_printf(out, "\033[%d;1HDepth: %d", MAX_HEIGHT + 3, dungeon->level->depth);
+    ok = ok && term_printf(out, "\033[%d;1HGold: %d", MAX_HEIGHT + 4,
+            total_gold(player->inventory->items, player->inventory->itemCount));
+    for (int y = 0; y < MAX_MESSAGES; ++y)
+        if (get_message(game, y) != NULL)
+            ok = ok && term_printf(out, "\033[%d;%dH%.*s",
+                    MAX_HEIGHT + y + 1, TERM_MESSAGE_X + 1,
+                    MAX_WIDTH - TERM_MESSAGE_X, get_message(game, y));
+
+    // leave the cursor on the player, like a curses roguelike
+    ok = ok && term_printf(out, "\033[%d;%dH" TERM_FRAME_END,
+            (int) (player->coords.y - game->camera.y) + 1,
+            (int) (player->coords.x - game->camera.x) + 1);
+
+    return ok;
+}
+
+/*************/
+/**         **/
+/** private **/
+/**         **/
+/*************/
+
+int term_printf(Output *out, const char *format, ...)
+{
+    char buffer[MAX_MESSAGE_LENGTH * 2];
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+
+    if (length < 0)
+        return 0;
+    if ((size_t) length >= sizeof(buffer))
+        length = sizeof(buffer) - 1;
+
+    return output_write(out, buffer, length);
+}
+
+// write symbol, as UTF-8 for wide characters
+int term_symbol(Output *out, SYMBOL symbol)
+{
+#if(NCURSES_WIDECHAR)
+    unsigned long c = symbol;
+    char buffer[4];
+    size_t length;
+    if (c < 0x80)
+    {
+        buffer[0] = c;
+        length = 1;
+    }
+    else if (c < 0x800)
+    {
+        buffer[0] = 0xc0 | (c >> 6);
+        buffer[1] = 0x80 | (c & 0x3f);
+        length = 2;
+    }
+    else if (c < 0x10000)
+    {
+        buffer[0] = 0xe0 | (c >> 12);
+        buffer[1] = 0x80 | ((c >> 6) & 0x3f);
+        buffer[2] = 0x80 | (c & 0x3f);
+        length = 3;
+    }
+    else
+    {
+        buffer[0] = 0xf0 | (c >> 18);
+        buffer[1] = 0x80 | ((c >> 12) & 0x3f);
+        buffer[2] = 0x80 | ((c >> 6) & 0x3f);
+        buffer[3] = 0x80 | (c & 0x3f);
+        length = 4;
+    }
+
+    return output_write(out, buffer, length);
+#else
+    return output_write(out, &symbol, 1);
+#endif
+}
+
+// ANSI foreground color of curses color pair (see init)
+int term_color(int colorPair)
+{
+    switch (colorPair)
+    {
+        case COLOR_PAIR_GREEN:
+            return 32;
+        case COLOR_PAIR_BROWN:
+            return 31;
+        case COLOR_PAIR_YELLOW:
+            return 33;
+        case COLOR_PAIR_BLACK:
+            return 30;
+        case COLOR_PAIR_PURPLE:
+            return 35;
+
+        default:
+            return 39;
+    }
+}
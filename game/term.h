@@ -0,0 +1,35 @@
+#ifndef TERM_H
+#define TERM_H
+
+#include "draw.h"
+#include <stddef.h>
+
+// ANSI terminal output backend: renders a game into a byte buffer instead of
+// curses, i.e. to send it over a socket. Each frame starts by hiding the
+// cursor & ends by showing it again, so clients can tell frames apart.
+
+#define TERM_FRAME_END "\033[?25h"
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Output;
+
+// append length bytes to out
+// returns 0 on OOM
+int output_write(Output *out, const char *data, size_t length);
+
+// drop the first count bytes of out (i.e. after they've been sent)
+void output_consume(Output *out, size_t count);
+
+// free buffer of out
+void output_free(Output *out);
+
+// render the next frame of game & append it to out: tiles changed since the
+// last frame (all of them if full, i.e. for a new client), the status area
+// & messages
+// returns 0 on OOM
+int render_term(Game *game, const Dungeon *dungeon, Output *out, int full);
+
+#endif
@@ -0,0 +1,93 @@
+#include "tiles.h"
+#include <string.h>
+
+int init_tile_set(TileSet *set, const RL_Map *map, int rooms, Arena *arena)
+{
+    size_t area = map->width * map->height;
+    *set = (TileSet) {0};
+    set->width = map->width;
+    set->height = map->height;
+    set->tiles = arena_alloc(arena, area * sizeof(RL_Point));
+    set->slots = arena_alloc(arena, area * sizeof(int));
+    set->origins = arena_alloc(arena, area * sizeof(int));
+    if (set->tiles == NULL || set->slots == NULL || set->origins == NULL)
+        return 0;
+
+    for (unsigned int y = 0; y < map->height; ++y)
+    {
+        for (unsigned int x = 0; x < map->width; ++x)
+        {
+            int in = rooms ? rl_map_tile_is(map, x, y, RL_TileRoom) : rl_map_is_passable(map, x, y);
+            set->slots[y * map->width + x] = in ? set->count : -1;
+            if (in)
+                set->tiles[set->count++] = RL_XY(x, y);
+        }
+    }
+
+    return 1;
+}
+
+int copy_tile_set(TileSet *copy, const TileSet *set, Arena *arena)
+{
+    size_t area = set->width * set->height;
+    *copy = *set;
+    copy->tiles = arena_alloc(arena, area * sizeof(RL_Point));
+    copy->slots = arena_alloc(arena, area * sizeof(int));
+    copy->origins = arena_alloc(arena, area * sizeof(int));
+    if (copy->tiles == NULL || copy->slots == NULL || copy->origins == NULL)
+        return 0;
+
+    memcpy(copy->tiles, set->tiles, set->count * sizeof(RL_Point));
+    memcpy(copy->slots, set->slots, area * sizeof(int));
+    memcpy(copy->origins, set->origins, set->excluded * sizeof(int));
+
+    return 1;
+}
+
+void swap_tiles(TileSet *set, int a, int b);
+void exclude_tile(TileSet *set, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= (int) set->width || y >= (int) set->height)
+        return;
+
+    int slot = set->slots[y * set->width + x];
+    if (slot < set->excluded) // not in set or excluded already
+        return;
+
+    set->origins[set->excluded] = slot;
+    swap_tiles(set, set->excluded++, slot);
+}
+
+void restore_tiles(TileSet *set)
+{
+    while (set->excluded > 0)
+    {
+        --set->excluded;
+        swap_tiles(set, set->excluded, set->origins[set->excluded]);
+    }
+}
+
+int pick_tile(const TileSet *set, RNG *rng, RL_Point *coords)
+{
+    if (set->excluded >= set->count)
+        return 0;
+
+    *coords = set->tiles[generate(rng, set->excluded, set->count - 1)];
+
+    return 1;
+}
+
+/*************/
+/**         **/
+/** private **/
+/**         **/
+/*************/
+
+void swap_tiles(TileSet *set, int a, int b)
+{
+    RL_Point tile = set->tiles[a];
+    set->tiles[a] = set->tiles[b];
+    set->tiles[b] = tile;
+    set->slots[(int) set->tiles[a].y * set->width + (int) set->tiles[a].x] = a;
+    set->slots[(int) set->tiles[b].y * set->width + (int) set->tiles[b].x] = b;
+}
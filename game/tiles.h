@@ -0,0 +1,41 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include "arena.h"
+#include "random.h"
+#include "lib/roguelike.h"
+
+// Set of map tiles to pick uniformly random ones from in O(1), i.e. to
+// place stairs & spawn mobs. Tiles can be excluded for one pick by moving
+// them to the front of the list (see exclude_tile), picks only roll over the
+// rest. restore_tiles undoes the moves in reverse, so between picks the
+// list is always in map order & a roll only depends on the map & what was
+// excluded.
+typedef struct {
+    RL_Point *tiles; // excluded tiles first, then the rest in map order
+    int *slots; // index of each map tile in tiles (y * width + x), -1 if not in set
+    int *origins; // slot each excluded tile was moved from
+    int count;
+    int excluded; // tiles at the front that can't be picked
+    unsigned int width, height;
+} TileSet;
+
+// fill set with the passable tiles of map, only rooms if rooms is 1, the
+// set is freed with arena
+// returns 0 on OOM
+int init_tile_set(TileSet *set, const RL_Map *map, int rooms, Arena *arena);
+
+// returns 0 on OOM
+int copy_tile_set(TileSet *copy, const TileSet *set, Arena *arena);
+
+// don't pick tile until restore_tiles, tiles outside the set are ignored
+void exclude_tile(TileSet *set, int x, int y);
+
+// make excluded tiles pickable again
+void restore_tiles(TileSet *set);
+
+// pick a random tile that isn't excluded
+// returns 0 if there is none
+int pick_tile(const TileSet *set, RNG *rng, RL_Point *coords);
+
+#endif
@@ -0,0 +1,356 @@
+// simplerl-load: load generator for simplerl-server. Every session is a
+// small bot that presses a random movement key, waits for the frame it
+// produced, thinks & repeats. Sessions whose game ends reconnect as a new
+// game. Reports frames per second & input to frame latency.
+//
+// usage: simplerl-load [-u path | -p port] [-w path] [-c sessions] [-S spectators] [-d seconds] [-r keys per second] [-P server pid]
+//
+// Spectators watch the newest game (rejoining when it ends) & only read,
+// to see what they cost the server & the players' latency.
+//
+// With -P the CPU time the server used is read from /proc, to report how
+// many sessions one busy core can serve.
+
+#include "game/random.h"
+#include "game/term.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOAD_SOCKET   "simplerl.sock"
+#define LOAD_WATCH    "simplerl-watch.sock"
+#define LOAD_SESSIONS 100
+#define LOAD_SECONDS  10
+#define LOAD_RATE     5 // keys per second & session, about a human player
+
+typedef struct {
+    int fd;
+    int spectator; // 1 if only watching
+    RNG rng;
+    int waiting; // 1 while waiting for a frame
+    double sent; // when the last key was sent, -1 for the first frame
+    double next; // when to send the next key
+    size_t matched; // bytes of TERM_FRAME_END matched so far
+} LoadSession;
+
+typedef struct {
+    const char *path;
+    const char *watchPath;
+    int port;
+    double rate;
+    int epoll;
+
+    double *latencies; // seconds
+    long latencyCount, latencyCapacity;
+    long games;
+    long errors;
+    long watched; // bytes spectators received
+} Load;
+
+double load_now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// returns connected non-blocking socket to the game or watch socket, -1 on
+// error
+int connect_socket(const Load *load, int watch)
+{
+    int fd;
+    if (load->port)
+    {
+        struct sockaddr_in address = {0};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(watch ? load->port + 1 : load->port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_un address = {0};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, watch ? load->watchPath : load->path, sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd >= 0)
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    return fd;
+}
+
+// (re)connect session & wait for the first frame of its game
+// returns 0 on error
+int start_session(Load *load, LoadSession *session)
+{
+    session->fd = connect_socket(load, session->spectator);
+    if (session->fd < 0)
+        return 0;
+
+    // newest game
+    if (session->spectator && send(session->fd, "\n", 1, MSG_NOSIGNAL) != 1)
+    {
+        close(session->fd);
+
+        return 0;
+    }
+
+    session->waiting = 1;
+    session->sent = -1;
+    session->matched = 0;
+
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = session;
+
+    return epoll_ctl(load->epoll, EPOLL_CTL_ADD, session->fd, &event) == 0;
+}
+
+// seconds to think before the next key, 0 - 2 / rate
+double think(Load *load, LoadSession *session)
+{
+    return generate(&session->rng, 0, 2000) / (1000 * load->rate);
+}
+
+void add_latency(Load *load, double latency)
+{
+    if (load->latencyCount == load->latencyCapacity)
+    {
+        long capacity = load->latencyCapacity ? load->latencyCapacity * 2 : 4096;
+        double *latencies = realloc(load->latencies, capacity * sizeof(double));
+        if (latencies == NULL)
+            return;
+
+        load->latencies = latencies;
+        load->latencyCapacity = capacity;
+    }
+
+    load->latencies[load->latencyCount++] = latency;
+}
+
+// read output of session, recording the latency of each finished frame
+void read_load_session(Load *load, LoadSession *session, double now)
+{
+    const char *end = TERM_FRAME_END;
+    size_t endLength = strlen(end);
+    char buffer[16384];
+
+    for (;;)
+    {
+        ssize_t count = recv(session->fd, buffer, sizeof(buffer), 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+
+        // game over, start a new one
+        if (count <= 0)
+        {
+            close(session->fd);
+            if (count < 0)
+                ++load->errors;
+            if (!start_session(load, session))
+                ++load->errors;
+            else if (!session->spectator)
+                ++load->games;
+
+            return;
+        }
+
+        if (session->spectator)
+        {
+            load->watched += count;
+            continue;
+        }
+
+        for (ssize_t i = 0; i < count; ++i)
+        {
+            if (buffer[i] != end[session->matched])
+                session->matched = buffer[i] == end[0];
+            else if (++session->matched == endLength)
+            {
+                session->matched = 0;
+                if (session->waiting && session->sent >= 0)
+                    add_latency(load, now - session->sent);
+                session->waiting = 0;
+                session->next = now + think(load, session);
+            }
+        }
+    }
+}
+
+int compare_latency(const void *a, const void *b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+
+    return (x > y) - (x < y);
+}
+
+double percentile(const Load *load, double p)
+{
+    if (load->latencyCount == 0)
+        return 0;
+
+    long i = p * (load->latencyCount - 1);
+
+    return load->latencies[i];
+}
+
+// CPU seconds used by process pid, -1 if unknown
+double cpu_seconds(int pid)
+{
+    char filename[64];
+    snprintf(filename, sizeof(filename), "/proc/%d/stat", pid);
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+        return -1;
+
+    char stat[1024];
+    size_t length = fread(stat, 1, sizeof(stat) - 1, file);
+    fclose(file);
+    stat[length] = '\0';
+
+    // skip pid & (name), utime & stime are the 14th & 15th fields
+    unsigned long utime, stime;
+    const char *fields = strrchr(stat, ')');
+    if (fields == NULL || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+        return -1;
+
+    return (double) (utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+int main(int argc, const char **argv)
+{
+    Load load = {0};
+    load.path = LOAD_SOCKET;
+    load.watchPath = LOAD_WATCH;
+    load.rate = LOAD_RATE;
+    int sessionCount = LOAD_SESSIONS;
+    int spectatorCount = 0;
+    double seconds = LOAD_SECONDS;
+    int pid = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+            load.path = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            load.port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            load.watchPath = argv[++i];
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            sessionCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc)
+            spectatorCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            load.rate = atof(argv[++i]);
+        else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc)
+            pid = atoi(argv[++i]);
+        else
+        {
+            printf("Usage: simplerl-load [-u path | -p port] [-w path] [-c sessions] [-S spectators] [-d seconds] [-r keys per second] [-P server pid]\n");
+
+            return 99;
+        }
+    }
+    if (sessionCount <= 0 || spectatorCount < 0 || seconds <= 0 || load.rate <= 0)
+        return 99;
+
+    // spectators come after the players
+    int total = sessionCount + spectatorCount;
+    LoadSession *sessions = calloc(total, sizeof(LoadSession));
+    struct epoll_event *events = calloc(total, sizeof(struct epoll_event));
+    load.epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (sessions == NULL || events == NULL || load.epoll < 0)
+        return 1;
+
+    for (int i = 0; i < total; ++i)
+    {
+        sessions[i].rng = split_stream(1, RNG_BOT, i);
+        sessions[i].spectator = i >= sessionCount;
+        if (!start_session(&load, &sessions[i]))
+        {
+            fprintf(stderr, "ERROR: Unable to connect session %d.\n", i + 1);
+
+            return 1;
+        }
+    }
+
+    double cpuStart = pid ? cpu_seconds(pid) : -1;
+    double start = load_now(), now = start;
+    long keys = 0;
+    while (now - start < seconds)
+    {
+        // send keys that are due & wait until the next one is
+        double next = start + seconds;
+        for (int i = 0; i < sessionCount; ++i)
+        {
+            LoadSession *session = &sessions[i];
+            if (session->waiting)
+                continue;
+
+            if (session->next <= now)
+            {
+                char key = "hjkl"[generate(&session->rng, 0, 3)];
+                if (send(session->fd, &key, 1, MSG_NOSIGNAL) == 1)
+                {
+                    session->waiting = 1;
+                    session->sent = now;
+                    ++keys;
+                }
+                else
+                    session->next = now + think(&load, session);
+            }
+
+            if (!session->waiting && session->next < next)
+                next = session->next;
+        }
+
+        int timeout = (next - now) * 1000;
+        int count = epoll_wait(load.epoll, events, total, timeout > 0 ? timeout : 0);
+        now = load_now();
+        for (int i = 0; i < count; ++i)
+            read_load_session(&load, events[i].data.ptr, now);
+    }
+    double elapsed = now - start;
+    double cpu = pid && cpuStart >= 0 ? cpu_seconds(pid) - cpuStart : -1;
+
+    qsort(load.latencies, load.latencyCount, sizeof(double), compare_latency);
+    printf("%d sessions for %.1f seconds at %.1f keys per second: %ld keys, %ld frames (%.0f per second), %ld new games, %ld errors.\n",
+            sessionCount, elapsed, load.rate, keys, load.latencyCount, load.latencyCount / elapsed, load.games, load.errors);
+    printf("Input to frame latency: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms.\n",
+            percentile(&load, 0.5) * 1000,
+            percentile(&load, 0.9) * 1000,
+            percentile(&load, 0.99) * 1000,
+            percentile(&load, 1) * 1000);
+    if (spectatorCount)
+        printf("%d spectators received %.1f kB per second.\n", spectatorCount, load.watched / elapsed / 1024);
+    if (cpu > 0)
+        printf("Server used %.2f cores: %.0f sessions per core.\n", cpu / elapsed, sessionCount / (cpu / elapsed));
+
+    return 0;
+}
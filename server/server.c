@@ -0,0 +1,771 @@
+// simplerl-server: host many games from one process. Clients connect over a
+// Unix or TCP socket & send keys (hjkl etc., like a raw mode terminal),
+// every turn is sent back as ANSI terminal output (see term.h).
+//
+// usage: simplerl-server [-u path | -p port] [-w path] [-j threads] [-s seed]
+//
+// A small pool of workers share one epoll instance. Sessions are registered
+// one-shot, so only one worker owns a session at a time: it reads the keys,
+// steps gameloop until more input is needed, renders into the session's
+// output buffer, sends what the socket takes & re-arms the session. Nothing
+// blocks, so a few threads can run thousands of sessions. Everything a game
+// needs is in its session (RNG streams & world hash are in its context).
+//
+// Spectators connect to the watch socket (-w path, or port + 1) & send the
+// number of a game followed by a newline, or just a newline for the newest
+// game. Each frame of a watched game is encoded once into its broadcast ring
+// (see broadcast.h) & a single spectator thread sends it to every
+// spectator straight from there.
+
+#define _GNU_SOURCE // accept4
+#define RL_IMPLEMENTATION
+#include "lib/roguelike.h"
+
+#include "game/game.h"
+#include "game/context.h"
+#include "game/table.h"
+#include "game/term.h"
+#include "game/broadcast.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE 0
+#endif
+
+#define SERVER_SOCKET     "simplerl.sock"
+#define SERVER_WATCH      "simplerl-watch.sock"
+#define SERVER_EVENTS     16      // events handled per epoll_wait, per worker
+#define SERVER_READ       256     // keys read at once
+#define SERVER_MAX_OUTPUT (1<<20) // sessions that stop reading are dropped
+
+typedef struct {
+    int fd;
+    Game *game;
+    Dungeon *dungeon;
+    int result; // of last gameloop, the session ends once it isn't GAME_PLAYING
+    Output output; // not sent yet
+    Broadcast *broadcast; // frames for spectators
+
+    // released before the session is handed back to epoll & acquired by the
+    // next worker, epoll orders them too but the C memory model doesn't know
+    atomic_int handoff;
+} Session;
+
+typedef struct {
+    int fd;
+    Broadcast *broadcast; // NULL until the game has been picked
+    uint64_t offset; // in broadcast
+    char request[32]; // game number
+    int requestLength;
+    int blocked; // 1 while waiting for the socket to take more
+    int closed; // 1 once it's done, it's freed after the events in flight
+} Spectator;
+
+typedef struct {
+    int epoll;
+    int listener;
+    unsigned long seed;
+    atomic_ulong sessions; // started so far, new games use seed + sessions
+
+    // live games for spectators, oldest first
+    pthread_mutex_t gamesLock;
+    Broadcast **games;
+    int gameCount, gameCapacity;
+
+    // spectators are all handled by one thread, woken up by the games
+    int watchEpoll;
+    int watchListener;
+    int wake; // eventfd
+} Server;
+
+void wake_spectators(Server *server)
+{
+    eventfd_write(server->wake, 1);
+}
+
+// add broadcast to the live games
+// returns 0 on OOM
+int add_game(Server *server, Broadcast *broadcast)
+{
+    pthread_mutex_lock(&server->gamesLock);
+    if (server->gameCount == server->gameCapacity)
+    {
+        int capacity = server->gameCapacity ? server->gameCapacity * 2 : 64;
+        Broadcast **games = realloc(server->games, capacity * sizeof(Broadcast*));
+        if (games == NULL)
+        {
+            pthread_mutex_unlock(&server->gamesLock);
+
+            return 0;
+        }
+
+        server->games = games;
+        server->gameCapacity = capacity;
+    }
+    server->games[server->gameCount++] = broadcast;
+    pthread_mutex_unlock(&server->gamesLock);
+
+    return 1;
+}
+
+void remove_game(Server *server, Broadcast *broadcast)
+{
+    pthread_mutex_lock(&server->gamesLock);
+    for (int i = 0; i < server->gameCount; ++i)
+    {
+        if (server->games[i] == broadcast)
+        {
+            memmove(&server->games[i], &server->games[i + 1], (server->gameCount - i - 1) * sizeof(Broadcast*));
+            --server->gameCount;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->gamesLock);
+}
+
+// returns live game with id (the newest if id is 0) with a reference for
+// the caller, NULL if there's none
+Broadcast *find_game(Server *server, unsigned long id)
+{
+    Broadcast *broadcast = NULL;
+
+    pthread_mutex_lock(&server->gamesLock);
+    for (int i = server->gameCount - 1; i >= 0 && broadcast == NULL; --i)
+        if (id == 0 || server->games[i]->id == id)
+            broadcast = server->games[i];
+    if (broadcast)
+        retain_broadcast(broadcast);
+    pthread_mutex_unlock(&server->gamesLock);
+
+    return broadcast;
+}
+
+void close_session(Server *server, Session *session)
+{
+    // spectators see the end of the game before they're disconnected
+    if (session->broadcast)
+    {
+        remove_game(server, session->broadcast);
+        end_broadcast(session->broadcast);
+        wake_spectators(server);
+        release_broadcast(session->broadcast);
+    }
+
+    close(session->fd);
+    if (session->dungeon)
+        destroy_dungeon(session->dungeon);
+    destroy_game(session->game);
+    output_free(&session->output);
+    free(session);
+}
+
+int render_session(Server *server, Session *session, int full);
+
+// start a new game for client fd & render its first frame
+// returns NULL on OOM, fd is closed then
+Session *open_session(Server *server, int fd)
+{
+    Session *session = calloc(1, sizeof(Session));
+    if (session == NULL)
+    {
+        close(fd);
+
+        return NULL;
+    }
+
+    session->fd = fd;
+    session->result = GAME_PLAYING;
+    session->game = create_game();
+    if (session->game == NULL)
+    {
+        close_session(server, session);
+
+        return NULL;
+    }
+    session->game->hasColor = 1;
+
+    unsigned long seed = server->seed + atomic_fetch_add(&server->sessions, 1);
+    session->broadcast = create_broadcast(seed);
+    if (session->broadcast == NULL || !add_game(server, session->broadcast))
+    {
+        if (session->broadcast)
+            release_broadcast(session->broadcast);
+        session->broadcast = NULL;
+        close_session(server, session);
+
+        return NULL;
+    }
+
+    Dungeon *dungeon = create_dungeon(session->game, seed);
+    session->dungeon = dungeon;
+    if (dungeon == NULL || !init_level(session->game, dungeon->level, dungeon->player))
+    {
+        close_session(server, session);
+
+        return NULL;
+    }
+    update_fov(dungeon->level);
+
+    message(session->game, "Welcome to simplerl! Game %lu.", seed);
+    if (!render_session(server, session, 1))
+    {
+        close_session(server, session);
+
+        return NULL;
+    }
+
+    return session;
+}
+
+// play key, stepping the game on until it needs more input
+void play_key(Session *session, int key)
+{
+    Game *game = session->game;
+    Dungeon *dungeon = session->dungeon;
+
+    // the game can't be saved on the server, so keep playing
+    if (key == 'S' && !get_menu(game))
+    {
+        message(game, "Saving is not supported on this server.");
+
+        return;
+    }
+
+    session->result = gameloop(game, dungeon, key);
+    while (session->result == GAME_PLAYING && !handle_input(game, dungeon))
+        session->result = gameloop(game, dungeon, '.');
+}
+
+// write the result of a finished game after its last frame
+int end_session(Session *session)
+{
+    Dungeon *dungeon = session->dungeon;
+    const char *text;
+    switch (session->result)
+    {
+        case GAME_WON:
+            text = "You won!";
+            break;
+        case GAME_DEATH:
+            text = "Oh no, you died :(";
+            break;
+        case GAME_QUIT:
+            text = "You quit.";
+            break;
+
+        default:
+            text = "Game over.";
+            break;
+    }
+
+    char buffer[MAX_WIDTH * 2];
+    int length = snprintf(buffer, sizeof(buffer), "\033[0m\033[%d;1H\033[J%s You reached dungeon level %d.\r\n",
+            MAX_HEIGHT + MAX_MESSAGES + 1, text, max_depth(dungeon));
+
+    return output_write(&session->output, buffer, length);
+}
+
+// render the next frame for the player & spectators, it's only encoded once
+// returns 0 on OOM
+int render_session(Server *server, Session *session, int full)
+{
+    Output *output = &session->output;
+    size_t start = output->length;
+
+    int mode = broadcast_mode(session->broadcast);
+    int keyframe = full || mode == BROADCAST_KEYFRAME;
+    if (!render_term(session->game, session->dungeon, output, keyframe))
+        return 0;
+    if (session->result != GAME_PLAYING && !end_session(session))
+        return 0;
+
+    if (mode != BROADCAST_IDLE)
+    {
+        // a dropped delta is followed by a keyframe, a keyframe that doesn't
+        // fit never will
+        if (!broadcast_frame(session->broadcast, output->data + start, output->length - start, keyframe) && keyframe)
+            end_broadcast(session->broadcast);
+        wake_spectators(server);
+    }
+
+    return 1;
+}
+
+// read & play all keys the client sent
+// returns 0 if the session needs to be closed
+int read_session(Server *server, Session *session)
+{
+    char keys[SERVER_READ];
+    int played = 0, open = 1;
+
+    for (;;)
+    {
+        ssize_t count = recv(session->fd, keys, sizeof(keys), 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+        {
+            open = count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+            break;
+        }
+
+        // keys after the end of the game are ignored
+        for (ssize_t i = 0; i < count && session->result == GAME_PLAYING; ++i, ++played)
+            play_key(session, (unsigned char) keys[i]);
+    }
+
+    // one frame for everything that was played
+    int ok = 1;
+    if (played && open)
+        ok = render_session(server, session, 0);
+
+    return open && ok && session->output.length <= SERVER_MAX_OUTPUT;
+}
+
+// send as much output as the socket takes
+// returns 0 if the session needs to be closed
+int write_session(Session *session)
+{
+    Output *output = &session->output;
+    while (output->length > 0)
+    {
+        ssize_t count = send(session->fd, output->data, output->length, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+
+        output_consume(output, count);
+    }
+
+    return 1;
+}
+
+// hand session back to epoll, or close it once it's finished
+void arm_session(Server *server, Session *session, int op)
+{
+    if (session->result != GAME_PLAYING && session->output.length == 0)
+    {
+        close_session(server, session);
+
+        return;
+    }
+
+    struct epoll_event event = {0};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    if (session->output.length > 0)
+        event.events |= EPOLLOUT;
+    event.data.ptr = session;
+
+    // the session mustn't be touched after this, unless epoll_ctl fails
+    atomic_store_explicit(&session->handoff, 1, memory_order_release);
+    if (epoll_ctl(server->epoll, op, session->fd, &event) != 0)
+        close_session(server, session);
+}
+
+void accept_sessions(Server *server)
+{
+    for (;;)
+    {
+        int fd = accept4(server->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0 && errno == EINTR)
+            continue;
+        if (fd < 0)
+            return; // EAGAIN, or out of fds until a session closes
+
+        Session *session = open_session(server, fd);
+        if (session == NULL)
+            continue;
+
+        if (!write_session(session))
+            close_session(server, session);
+        else
+            arm_session(server, session, EPOLL_CTL_ADD);
+    }
+}
+
+void *server_worker(void *arg)
+{
+    Server *server = arg;
+    struct epoll_event events[SERVER_EVENTS];
+
+    for (;;)
+    {
+        int count = epoll_wait(server->epoll, events, SERVER_EVENTS, -1);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            break;
+
+        for (int i = 0; i < count; ++i)
+        {
+            Session *session = events[i].data.ptr;
+            if (session == NULL)
+            {
+                accept_sessions(server);
+                continue;
+            }
+
+            atomic_load_explicit(&session->handoff, memory_order_acquire);
+
+            int ok = !(events[i].events & EPOLLERR);
+            if (ok && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+                ok = read_session(server, session);
+            if (ok)
+                ok = write_session(session);
+
+            if (ok)
+                arm_session(server, session, EPOLL_CTL_MOD);
+            else
+                close_session(server, session);
+        }
+    }
+
+    return NULL;
+}
+
+void close_spectator(Spectator *spectator)
+{
+    close(spectator->fd);
+    if (spectator->broadcast)
+    {
+        leave_broadcast(spectator->broadcast);
+        release_broadcast(spectator->broadcast);
+    }
+    free(spectator);
+}
+
+// send spectator what it hasn't seen yet
+// returns 0 if the spectator needs to be closed
+int send_spectator(Server *server, Spectator *spectator)
+{
+    int result = send_broadcast(spectator->broadcast, &spectator->offset, spectator->fd);
+    if (result == -1 || result == BROADCAST_ENDED)
+        return 0;
+
+    // wait for the socket to take more, then carry on
+    int blocked = result == BROADCAST_BLOCKED;
+    if (blocked != spectator->blocked)
+    {
+        struct epoll_event event = {0};
+        event.events = EPOLLIN | EPOLLRDHUP | (blocked ? EPOLLOUT : 0);
+        event.data.ptr = spectator;
+        if (epoll_ctl(server->watchEpoll, EPOLL_CTL_MOD, spectator->fd, &event) != 0)
+            return 0;
+        spectator->blocked = blocked;
+    }
+
+    return 1;
+}
+
+// read the game the spectator wants to watch, anything after is ignored
+// returns 0 if the spectator needs to be closed
+int read_spectator(Server *server, Spectator *spectator)
+{
+    char buffer[256];
+    for (;;)
+    {
+        ssize_t count = recv(spectator->fd, buffer, sizeof(buffer), 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        if (count == 0)
+            return 0;
+
+        for (ssize_t i = 0; i < count && spectator->broadcast == NULL; ++i)
+        {
+            if (buffer[i] != '\n' && buffer[i] != '\r')
+            {
+                if (spectator->requestLength + 1 >= (int) sizeof(spectator->request))
+                    return 0;
+                spectator->request[spectator->requestLength++] = buffer[i];
+                continue;
+            }
+
+            spectator->request[spectator->requestLength] = '\0';
+            spectator->broadcast = find_game(server, strtoul(spectator->request, NULL, 10));
+            if (spectator->broadcast == NULL)
+            {
+                const char *text = "No such game.\r\n";
+                send(spectator->fd, text, strlen(text), MSG_NOSIGNAL);
+
+                return 0;
+            }
+            if (!join_broadcast(spectator->broadcast, &spectator->offset))
+            {
+                release_broadcast(spectator->broadcast);
+                spectator->broadcast = NULL;
+
+                return 0;
+            }
+
+            // the game is asked for a keyframe on its next frame
+        }
+    }
+}
+
+void accept_spectators(Server *server, Spectator ***spectators, int *count, int *capacity)
+{
+    for (;;)
+    {
+        int fd = accept4(server->watchListener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0 && errno == EINTR)
+            continue;
+        if (fd < 0)
+            return;
+
+        if (*count == *capacity)
+        {
+            int grown = *capacity ? *capacity * 2 : 64;
+            Spectator **list = realloc(*spectators, grown * sizeof(Spectator*));
+            if (list == NULL)
+            {
+                close(fd);
+                continue;
+            }
+
+            *spectators = list;
+            *capacity = grown;
+        }
+
+        Spectator *spectator = calloc(1, sizeof(Spectator));
+        if (spectator == NULL)
+        {
+            close(fd);
+            continue;
+        }
+        spectator->fd = fd;
+
+        struct epoll_event event = {0};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = spectator;
+        if (epoll_ctl(server->watchEpoll, EPOLL_CTL_ADD, fd, &event) != 0)
+        {
+            close_spectator(spectator);
+            continue;
+        }
+        (*spectators)[(*count)++] = spectator;
+    }
+}
+
+// handles every spectator: games wake it up after each frame & it sends the
+// frame to everyone that can take it, the rest wait for EPOLLOUT
+void *spectator_thread(void *arg)
+{
+    Server *server = arg;
+    struct epoll_event events[SERVER_EVENTS];
+    Spectator **spectators = NULL;
+    int count = 0, capacity = 0;
+
+    for (;;)
+    {
+        int ready = epoll_wait(server->watchEpoll, events, SERVER_EVENTS, -1);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready < 0)
+            break;
+
+        int woken = 0;
+        for (int i = 0; i < ready; ++i)
+        {
+            Spectator *spectator = events[i].data.ptr;
+            if (spectator == NULL)
+            {
+                accept_spectators(server, &spectators, &count, &capacity);
+                continue;
+            }
+            if (events[i].data.ptr == server)
+            {
+                eventfd_t value;
+                eventfd_read(server->wake, &value);
+                woken = 1;
+                continue;
+            }
+
+            int ok = !(events[i].events & (EPOLLERR | EPOLLHUP));
+            if (ok && (events[i].events & (EPOLLIN | EPOLLRDHUP)))
+                ok = read_spectator(server, spectator);
+            if (ok && spectator->broadcast)
+                ok = send_spectator(server, spectator);
+            if (!ok)
+                spectator->closed = 1;
+        }
+
+        // new frames for everyone that's not waiting on its socket, & drop
+        // the closed spectators
+        for (int i = 0; i < count; ++i)
+        {
+            Spectator *spectator = spectators[i];
+            int ok = !spectator->closed;
+            if (ok && woken && spectator->broadcast && !spectator->blocked)
+                ok = send_spectator(server, spectator);
+            if (ok)
+                continue;
+
+            close_spectator(spectator);
+            spectators[i--] = spectators[--count];
+        }
+    }
+
+    return NULL;
+}
+
+// returns listening socket, -1 on error
+int listen_socket(const char *path, int port)
+{
+    int fd;
+    if (port)
+    {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        // local players & load tests only
+        struct sockaddr_in address = {0};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+        {
+            close(fd);
+
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_un address = {0};
+        if (strlen(path) >= sizeof(address.sun_path))
+            return -1;
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return -1;
+
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, path);
+        unlink(path);
+        if (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+        {
+            close(fd);
+
+            return -1;
+        }
+    }
+
+    if (listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+int main(int argc, const char **argv)
+{
+    const char *path = SERVER_SOCKET;
+    const char *watchPath = SERVER_WATCH;
+    int port = 0;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long seed = time(0);
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+            path = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            watchPath = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = strtoul(argv[++i], NULL, 10);
+        else
+        {
+            printf("Usage: simplerl-server [-u path | -p port] [-w path] [-j threads] [-s seed]\n");
+
+            return 99;
+        }
+    }
+    if (threads < 1)
+        threads = 1;
+
+    // tables are shared read-only by every session
+    init_tables();
+
+    Server server = {0};
+    server.seed = seed;
+    atomic_init(&server.sessions, 0);
+    pthread_mutex_init(&server.gamesLock, NULL);
+    server.listener = listen_socket(path, port);
+    server.watchListener = listen_socket(watchPath, port ? port + 1 : 0);
+    if (server.listener < 0 || server.watchListener < 0)
+    {
+        perror("ERROR: Unable to listen");
+
+        return 1;
+    }
+
+    server.epoll = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {0};
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = NULL; // the listener
+    if (server.epoll < 0 || epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &event) != 0)
+    {
+        perror("ERROR: Unable to create epoll instance");
+
+        return 1;
+    }
+
+    server.watchEpoll = epoll_create1(EPOLL_CLOEXEC);
+    server.wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event watchEvent = {0}, wakeEvent = {0};
+    watchEvent.events = EPOLLIN;
+    watchEvent.data.ptr = NULL; // the listener
+    wakeEvent.events = EPOLLIN;
+    wakeEvent.data.ptr = &server;
+    pthread_t thread;
+    if (server.watchEpoll < 0 || server.wake < 0 ||
+            epoll_ctl(server.watchEpoll, EPOLL_CTL_ADD, server.watchListener, &watchEvent) != 0 ||
+            epoll_ctl(server.watchEpoll, EPOLL_CTL_ADD, server.wake, &wakeEvent) != 0 ||
+            pthread_create(&thread, NULL, spectator_thread, &server) != 0)
+    {
+        perror("ERROR: Unable to start spectator thread");
+
+        return 1;
+    }
+
+    if (port)
+        printf("Listening on 127.0.0.1:%d (spectators on %d) with %d workers.\n", port, port + 1, threads);
+    else
+        printf("Listening on %s (spectators on %s) with %d workers.\n", path, watchPath, threads);
+    fflush(stdout);
+
+    // this thread is a worker too
+    for (int i = 1; i < threads; ++i)
+        if (pthread_create(&thread, NULL, server_worker, &server) != 0)
+            break;
+    server_worker(&server);
+
+    return 1;
+}
@@ -0,0 +1,281 @@
+// simplerl-sim: play many headless games with the scripted bot on every
+// core & report depth, deaths, turns, gold & player level, i.e. to tune the
+// spawn & loot tables
+//
+// usage: simplerl-sim [-n games] [-j threads] [-s seed] [-t max turns] [-m WxH map size]
+//
+// Game i is played with seed + i, so results don't depend on the amount of
+// threads. Workers share the next game counter & take turns generating maps
+// (the lib's mapgen rolls with rand(), see randomly_fill_tiles), each one
+// keeps its own context, bot & stats & reuses them for every game it plays.
+
+#define RL_IMPLEMENTATION
+#include "lib/roguelike.h"
+
+#include "game/game.h"
+#include "game/context.h"
+#include "game/table.h"
+#include "game/bot.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SIM_GAMES     10000
+#define SIM_SEED      1
+#define SIM_MAX_TURNS 20000 // games still running after this are counted as stuck
+
+typedef struct {
+    long games;
+    long died, won, stuck, other; // by GAME result
+    long turns, maxTurns;
+    long gold, maxGold;
+    long depth[MAX_LEVEL + 1]; // games by deepest level reached
+    long level[MAX_PLAYER_LEVEL + 1]; // games by final player level
+    long deaths[MOB_SYMBOLS]; // deaths by killer symbol, 0 if not killed by a mob
+} SimStats;
+
+typedef struct {
+    pthread_t thread;
+    atomic_int *nextGame;
+    int games;
+    unsigned long seed;
+    int maxTurns;
+    unsigned int width, height; // map size
+    SimStats stats;
+} SimWorker;
+
+double sim_now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// play one game to the end (or the turn limit) & add it to stats
+void sim_game(SimWorker *worker, Game *game, Bot *bot, unsigned long seed)
+{
+    SimStats *stats = &worker->stats;
+
+    reset_game(game);
+    Dungeon *dungeon = create_dungeon(game, seed);
+    if (dungeon == NULL || !init_level(game, dungeon->level, dungeon->player))
+    {
+        ++stats->other;
+
+        return;
+    }
+    update_fov(dungeon->level);
+    init_bot(bot, seed);
+
+    // changing depth doesn't take a turn, so bound the calls too
+    int result = GAME_PLAYING;
+    for (int i = 0; result == GAME_PLAYING && dungeon->turn < worker->maxTurns && i < worker->maxTurns * 2; ++i)
+        result = gameloop(game, dungeon, handle_input(game, dungeon) ? bot_input(bot, game, dungeon) : '.');
+
+    Mob *player = dungeon->player;
+    int gold = total_gold(player->inventory->items, player->inventory->itemCount);
+
+    ++stats->games;
+    if (result == GAME_DEATH)
+    {
+        ++stats->died;
+        ++stats->deaths[game->killer & (MOB_SYMBOLS - 1)];
+    }
+    else if (result == GAME_WON)
+        ++stats->won;
+    else if (result == GAME_PLAYING)
+        ++stats->stuck;
+    else
+        ++stats->other;
+    stats->turns += dungeon->turn;
+    if (dungeon->turn > stats->maxTurns)
+        stats->maxTurns = dungeon->turn;
+    stats->gold += gold;
+    if (gold > stats->maxGold)
+        stats->maxGold = gold;
+    ++stats->depth[max_depth(dungeon)];
+    ++stats->level[player->attrs.level];
+
+    destroy_bot(bot);
+    destroy_dungeon(dungeon);
+}
+
+void *sim_worker(void *arg)
+{
+    SimWorker *worker = arg;
+
+    Game *game = create_game();
+    Bot *bot = malloc(sizeof(Bot));
+    if (game == NULL || bot == NULL)
+    {
+        free(bot);
+        destroy_game(game);
+
+        return NULL;
+    }
+    game->mapWidth = worker->width;
+    game->mapHeight = worker->height;
+
+    int i;
+    while ((i = atomic_fetch_add(worker->nextGame, 1)) < worker->games)
+        sim_game(worker, game, bot, worker->seed + i);
+
+    free(bot);
+    destroy_game(game);
+
+    return NULL;
+}
+
+void merge_stats(SimStats *total, const SimStats *stats)
+{
+    total->games += stats->games;
+    total->died += stats->died;
+    total->won += stats->won;
+    total->stuck += stats->stuck;
+    total->other += stats->other;
+    total->turns += stats->turns;
+    total->gold += stats->gold;
+    if (stats->maxTurns > total->maxTurns)
+        total->maxTurns = stats->maxTurns;
+    if (stats->maxGold > total->maxGold)
+        total->maxGold = stats->maxGold;
+    for (int i = 0; i <= MAX_LEVEL; ++i)
+        total->depth[i] += stats->depth[i];
+    for (int i = 0; i <= MAX_PLAYER_LEVEL; ++i)
+        total->level[i] += stats->level[i];
+    for (int i = 0; i < MOB_SYMBOLS; ++i)
+        total->deaths[i] += stats->deaths[i];
+}
+
+double percent(long amount, long total)
+{
+    return total ? 100.0 * amount / total : 0;
+}
+
+void print_report(const SimStats *stats, int threads, unsigned long seed, double seconds)
+{
+    long games = stats->games;
+
+    printf("Played %ld games (seeds %lu - %lu) on %d threads in %.2f seconds: %.0f games per minute, %.0f turns per second.\n\n",
+            games, seed, seed + games - 1, threads, seconds,
+            seconds > 0 ? games * 60 / seconds : 0,
+            seconds > 0 ? stats->turns / seconds : 0);
+
+    printf("Results:  died %ld (%.1f%%), won %ld (%.1f%%), stuck %ld (%.1f%%), other %ld\n",
+            stats->died, percent(stats->died, games),
+            stats->won, percent(stats->won, games),
+            stats->stuck, percent(stats->stuck, games),
+            stats->other);
+    printf("Turns:    mean %.1f, max %ld\n", games ? (double) stats->turns / games : 0, stats->maxTurns);
+    printf("Gold:     mean %.1f, max %ld\n", games ? (double) stats->gold / games : 0, stats->maxGold);
+
+    printf("\nDepth reached:\n");
+    for (int i = 1; i <= MAX_LEVEL; ++i)
+        if (stats->depth[i])
+            printf("  %2d  %8ld  %5.1f%%\n", i, stats->depth[i], percent(stats->depth[i], games));
+
+    printf("\nPlayer level:\n");
+    for (int i = 1; i <= MAX_PLAYER_LEVEL; ++i)
+        if (stats->level[i])
+            printf("  %2d  %8ld  %5.1f%%\n", i, stats->level[i], percent(stats->level[i], games));
+
+    // most common cause first
+    printf("\nDeaths by cause:\n");
+    int printed[MOB_SYMBOLS] = {0};
+    for (;;)
+    {
+        int worst = -1;
+        for (int i = 0; i < MOB_SYMBOLS; ++i)
+            if (stats->deaths[i] && !printed[i] && (worst == -1 || stats->deaths[i] > stats->deaths[worst]))
+                worst = i;
+        if (worst == -1)
+            break;
+
+        printed[worst] = 1;
+        printf("  %-12s  %8ld  %5.1f%%\n",
+                worst ? mob_name(worst) : "(other)",
+                stats->deaths[worst],
+                percent(stats->deaths[worst], stats->died));
+    }
+}
+
+int main(int argc, const char **argv)
+{
+    int games = SIM_GAMES;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long seed = SIM_SEED;
+    int maxTurns = SIM_MAX_TURNS;
+    unsigned int width = MAX_WIDTH, height = MAX_HEIGHT;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            games = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            maxTurns = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc &&
+                sscanf(argv[++i], "%ux%u", &width, &height) == 2)
+            continue;
+        else
+        {
+            printf("Usage: simplerl-sim [-n games] [-j threads] [-s seed] [-t max turns] [-m WxH map size]\n");
+
+            return 99;
+        }
+    }
+    if (games <= 0 || maxTurns <= 0 ||
+            width < MIN_MAP_SIZE || width > MAX_MAP_SIZE || height < MIN_MAP_SIZE || height > MAX_MAP_SIZE)
+        return 99;
+    if (threads < 1)
+        threads = 1;
+
+    // tables are shared read-only by every worker
+    init_tables();
+
+    SimWorker *workers = calloc(threads, sizeof(SimWorker));
+    if (workers == NULL)
+        return 1;
+
+    atomic_int nextGame;
+    atomic_init(&nextGame, 0);
+
+    double start = sim_now();
+    int started = 0;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers[i].nextGame = &nextGame;
+        workers[i].games = games;
+        workers[i].seed = seed;
+        workers[i].maxTurns = maxTurns;
+        workers[i].width = width;
+        workers[i].height = height;
+        if (pthread_create(&workers[i].thread, NULL, sim_worker, &workers[i]) != 0)
+            break;
+        ++started;
+    }
+    if (started == 0)
+        sim_worker(&workers[0]);
+
+    SimStats total = {0};
+    for (int i = 0; i < threads; ++i)
+    {
+        if (i < started)
+            pthread_join(workers[i].thread, NULL);
+        merge_stats(&total, &workers[i].stats);
+    }
+    double seconds = sim_now() - start;
+
+    print_report(&total, started ? started : 1, seed, seconds);
+    free(workers);
+
+    return total.games == games ? 0 : 1;
+}